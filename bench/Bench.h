@@ -0,0 +1,117 @@
+//
+// Minimal benchmark harness for space_bench: times a callable over a number of
+// iterations, writes the results as JSON, one benchmark per line, and compares
+// them with a saved baseline.
+//
+
+#ifndef PROJECT_BASE_BENCH_H
+#define PROJECT_BASE_BENCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <rg/FrameStats.h>
+
+class Bench {
+public:
+    struct Result {
+        std::string name;
+        unsigned int iterations;
+        FrameStats::Summary ms;
+    };
+
+private:
+    std::vector<Result> m_Results;
+    std::string m_Filter;
+
+public:
+    explicit Bench(std::string filter = "") : m_Filter(std::move(filter)) {
+    }
+
+    bool selected(const std::string &name) const {
+        return m_Filter.empty() || name.find(m_Filter) != std::string::npos;
+    }
+
+    // one untimed run first, so lazy driver work and cold caches are not measured
+    template <typename F>
+    void run(const std::string &name, unsigned int iterations, F body) {
+        if (!selected(name))
+            return;
+        body();
+        std::vector<float> samples;
+        samples.reserve(iterations);
+        for (unsigned int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            body();
+            samples.push_back(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        add(name, iterations, FrameStats::summarize(samples));
+    }
+
+    // results measured elsewhere, such as a headless run of the renderer
+    void add(const std::string &name, unsigned int iterations, const FrameStats::Summary &ms) {
+        m_Results.push_back(Result{name, iterations, ms});
+        std::printf("%-32s %6u  mean %9.4f  p50 %9.4f  p95 %9.4f  max %9.4f ms\n", name.c_str(), iterations,
+                    ms.mean, ms.p50, ms.p95, ms.max);
+    }
+
+    const std::vector<Result> &results() const {
+        return m_Results;
+    }
+
+    bool writeJson(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "{\"benchmarks\": [\n";
+        for (size_t i = 0; i < m_Results.size(); i++) {
+            const Result &r = m_Results[i];
+            out << "{\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"mean_ms\": " << r.ms.mean
+                << ", \"p50_ms\": " << r.ms.p50 << ", \"p95_ms\": " << r.ms.p95 << ", \"p99_ms\": " << r.ms.p99
+                << ", \"max_ms\": " << r.ms.max << "}" << (i + 1 < m_Results.size() ? "," : "") << "\n";
+        }
+        out << "]}\n";
+        return true;
+    }
+
+    // median time per benchmark from a file written by writeJson()
+    static bool loadBaseline(const std::string &path, std::map<std::string, double> &p50) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::regex entry("\"name\": \"([^\"]+)\".*\"p50_ms\": ([-+0-9.eE]+)");
+        std::string line;
+        std::smatch match;
+        while (std::getline(in, line))
+            if (std::regex_search(line, match, entry))
+                p50[match[1]] = std::stod(match[2]);
+        return true;
+    }
+
+    // compares medians; returns how many benchmarks got slower than the threshold allows
+    unsigned int compare(const std::map<std::string, double> &baseline, double thresholdPercent) const {
+        unsigned int regressions = 0;
+        std::printf("\n%-32s %12s %12s %9s\n", "benchmark", "baseline ms", "current ms", "change");
+        for (const Result &r : m_Results) {
+            auto it = baseline.find(r.name);
+            if (it == baseline.end()) {
+                std::printf("%-32s %12s %12.4f %9s\n", r.name.c_str(), "-", r.ms.p50, "new");
+                continue;
+            }
+            double change = it->second > 0.0 ? (r.ms.p50 - it->second) / it->second * 100.0 : 0.0;
+            bool regressed = change > thresholdPercent;
+            regressions += regressed;
+            std::printf("%-32s %12.4f %12.4f %+8.1f%%%s\n", r.name.c_str(), it->second, r.ms.p50, change,
+                        regressed ? "  REGRESSION" : "");
+        }
+        return regressions;
+    }
+};
+
+#endif //PROJECT_BASE_BENCH_H
@@ -0,0 +1,350 @@
+//
+// space_bench: microbenchmarks for the CPU hot paths (asset import, image
+// decode, shader builds, uniform uploads, transform batches, render queue
+// sorting, culling) and macro benchmarks that run project_base headless for a fixed
+// number of frames. Run from the repository root so resources/ resolves.
+//
+//   space_bench [--out bench.json] [--compare baseline.json] [--threshold 10]
+//               [--filter name] [--frames 300] [--size 1280x720] [--no-macro]
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <stb_image.h>
+#include <rg/GLHandle.h>
+#include <rg/Shader.h>
+#include <rg/Texture2D.h>
+#include <rg/model.h>
+#include <rg/TransformBatch.h>
+#include <rg/RenderQueue.h>
+#include <rg/StreamBuffer.h>
+#include <rg/PointShadows.h>
+#include <rg/StarCatalog.h>
+#include "Bench.h"
+
+struct Options {
+    std::string output = "space_bench.json";
+    std::string baseline;
+    double threshold = 10.0;
+    std::string filter;
+    unsigned int frames = 300;
+    std::string size = "1280x720";
+    bool macro = true;
+    std::string renderer = "./project_base";
+};
+
+// the benchmarks only need a context, never a visible window
+GLFWwindow *createContext() {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "space_bench", nullptr, nullptr);
+    const int contextApis[] = {GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API};
+    for (int api : contextApis) {
+        if (window != nullptr)
+            break;
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+        window = glfwCreateWindow(64, 64, "space_bench", nullptr, nullptr);
+    }
+    return window;
+}
+
+// GL objects go through the deletion queue; each iteration closes a frame
+// so the queue is drained as the GPU catches up instead of growing
+template <typename F>
+void runFrames(Bench &bench, const std::string &name, unsigned int iterations, F body) {
+    bench.run(name, iterations, [&body]() {
+        body();
+        GLDeletionQueue::endFrame();
+        GLDeletionQueue::collect();
+    });
+}
+
+void benchAssets(Bench &bench) {
+    runFrames(bench, "model.import.sun", 5, []() {
+        Model model("resources/objects/sun/13913_Sun_v2_l3.obj");
+    });
+    runFrames(bench, "model.import.runestone", 5, []() {
+        Model model("resources/objects/runestone/Runestones.obj");
+    });
+
+    // decode alone, then decode plus upload and mipmaps through both loaders
+    bench.run("image.decode", 20, []() {
+        int width, height, channels;
+        unsigned char *data = stbi_load("resources/textures/crystal.jpg", &width, &height, &channels, 0);
+        stbi_image_free(data);
+    });
+    runFrames(bench, "image.Texture2D", 20, []() {
+        Texture2D texture("resources/textures/crystal.jpg", true);
+    });
+    runFrames(bench, "image.TextureFromFile", 20, []() {
+        GLTexture texture = TextureFromFile("crystal.jpg", "resources/textures", true);
+    });
+
+    // drivers may cache compiled programs, so this is the warm path
+    runFrames(bench, "shader.build.lights", 20, []() {
+        Shader shader("resources/shaders/lights.vs", "resources/shaders/lights.fs");
+        shader.deleteProgram();
+    });
+    runFrames(bench, "shader.build.post", 20, []() {
+        Shader shader("resources/shaders/post.vs", "resources/shaders/post.fs", "",
+                      {"STAGE_GRADING", "STAGE_VIGNETTE", "STAGE_FXAA", "STAGE_DITHER"});
+        shader.deleteProgram();
+    });
+}
+
+void benchUniforms(Bench &bench) {
+    const unsigned int MATRICES = 200;
+    std::vector<glm::mat4> matrices(MATRICES, glm::mat4(1.0f));
+
+    Shader shader("resources/shaders/lights.vs", "resources/shaders/lights.fs");
+    shader.use();
+    // name lookup and one call per matrix, as every draw in the renderer does it
+    bench.run("uniform.setMat4", 200, [&]() {
+        for (const auto &matrix : matrices)
+            shader.setMat4("model", matrix);
+    });
+    GLint program = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+    GLint location = glGetUniformLocation(program, "model");
+    bench.run("uniform.glUniformMatrix4fv", 200, [&]() {
+        for (const auto &matrix : matrices)
+            glUniformMatrix4fv(location, 1, GL_FALSE, &matrix[0][0]);
+    });
+    shader.deleteProgram();
+
+    StreamBuffer stream(GL_UNIFORM_BUFFER, MATRICES * sizeof(glm::mat4));
+    bench.run("uniform.streamBuffer", 200, [&]() {
+        stream.beginFrame();
+        StreamBuffer::Allocation allocation = stream.allocate(MATRICES * sizeof(glm::mat4));
+        std::memcpy(allocation.data, matrices.data(), MATRICES * sizeof(glm::mat4));
+        stream.flush();
+        stream.bindRange(0, allocation);
+        stream.endFrame();
+    });
+    glFinish();
+}
+
+void benchTransforms(Bench &bench) {
+    const unsigned int OBJECTS = 4096;
+    std::vector<glm::mat4> models(OBJECTS);
+    for (unsigned int i = 0; i < OBJECTS; i++)
+        models[i] = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(i % 64, i / 64, -1.0f)),
+                                0.01f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    TransformBatch batch;
+    bench.run("transform.batch.4096", 200, [&]() {
+        batch.clear();
+        for (const auto &model : models)
+            batch.add(model);
+        batch.compute(viewProjection);
+    });
+    // the per-object glm path the batch replaced, for reference
+    std::vector<glm::mat4> mvp(OBJECTS);
+    std::vector<glm::mat3> normal(OBJECTS);
+    bench.run("transform.scalar.4096", 200, [&]() {
+        for (unsigned int i = 0; i < OBJECTS; i++) {
+            mvp[i] = viewProjection * models[i];
+            normal[i] = glm::transpose(glm::inverse(glm::mat3(models[i])));
+        }
+    });
+}
+
+void benchQueue(Bench &bench) {
+    const unsigned int DRAWS = 4096;
+    RenderQueue queue(100.0f);
+    unsigned int calls = 0;
+    bench.run("queue.sort.4096", 200, [&]() {
+        queue.reset();
+        for (unsigned int p = 0; p < 8; p++)
+            queue.addProgram([&calls]() { calls++; });
+        for (unsigned int m = 0; m < 64; m++)
+            queue.addMaterial([&calls]() { calls++; });
+        for (unsigned int i = 0; i < DRAWS; i++) {
+            auto pass = i % 5 == 0 ? RenderQueue::TRANSPARENT : RenderQueue::OPAQUE;
+            queue.submit(pass, (i * 7) % 8, (i * 13) % 64, (float)((i * 2654435761u) % 1000) / 10.0f,
+                         [&calls]() { calls++; });
+        }
+        queue.execute();
+    });
+}
+
+void benchCulling(Bench &bench) {
+    // casters scattered around the light, some beyond its range, as the point shadow pass sees them
+    const unsigned int CASTERS = 4096;
+    std::vector<glm::vec4> casters(CASTERS);
+    for (unsigned int i = 0; i < CASTERS; i++) {
+        float a = 0.37f * i, b = 0.11f * i;
+        float distance = 2.0f + (float)((i * 2654435761u) % 3000) / 100.0f;
+        casters[i] = glm::vec4(distance * std::cos(a) * std::cos(b), distance * std::sin(b),
+                               distance * std::sin(a) * std::cos(b), 0.5f + (float)(i % 7) * 0.25f);
+    }
+    unsigned int faceDraws = 0;
+    bench.run("cull.cube_faces.4096", 200, [&]() {
+        int faces[6];
+        for (const auto &caster : casters)
+            faceDraws += PointShadows::touchedFaces(glm::vec3(0.0f), 25.0f, glm::vec3(caster), caster.w, faces);
+    });
+
+    // a synthetic catalog, the real one is not part of the repository
+    const char *csv = "space_bench_stars.csv";
+    const char *binary = "space_bench_stars.bin";
+    {
+        std::ofstream out(csv);
+        out << "ra,dec,mag,ci\n";
+        for (unsigned int i = 0; i < 100000; i++)
+            out << (i * 0.000241f) << "," << (std::fmod(i * 0.0137f, 180.0f) - 90.0f) << ","
+                << (-1.5f + (float)((i * 2654435761u) % 2000) / 100.0f) << ",0.6\n";
+    }
+    {
+        StarCatalog stars(csv, binary, 100000);
+        // the limiting magnitude for every zoom level the camera allows
+        uint32_t drawn = 0;
+        bench.run("cull.stars.visible", 200, [&]() {
+            float limit;
+            for (float fov = 1.0f; fov <= 45.0f; fov += 0.5f)
+                drawn += stars.visible(fov, limit);
+        });
+    }
+    std::remove(csv);
+    std::remove(binary);
+}
+
+// a headless run of the renderer itself, its statistics become macro.* results
+bool benchFrames(Bench &bench, const Options &options) {
+    if (!options.filter.empty() && options.filter.find("macro") == std::string::npos)
+        return true;
+    std::string report = "space_bench_frames.json";
+    std::ostringstream command;
+    command << options.renderer << " --headless --frames " << options.frames << " --size " << options.size
+            << " --bench-out " << report;
+    std::cout << "running " << command.str() << std::endl;
+    if (std::system(command.str().c_str()) != 0) {
+        std::cout << "Headless run failed" << std::endl;
+        return false;
+    }
+
+    std::ifstream in(report);
+    std::stringstream contents;
+    contents << in.rdbuf();
+    std::string json = contents.str();
+    const std::string number = "([-+0-9.eE]+)";
+    const std::string summary = "\\{\"mean\": " + number + ", \"p50\": " + number + ", \"p95\": " + number +
+                                ", \"p99\": " + number + ", \"max\": " + number + "\\}";
+    auto toSummary = [](const std::smatch &match, int first) {
+        FrameStats::Summary s;
+        s.mean = std::stod(match[first]);
+        s.p50 = std::stod(match[first + 1]);
+        s.p95 = std::stod(match[first + 2]);
+        s.p99 = std::stod(match[first + 3]);
+        s.max = std::stod(match[first + 4]);
+        return s;
+    };
+
+    std::smatch match;
+    if (!std::regex_search(json, match, std::regex("\"frame_ms\": " + summary))) {
+        std::cout << "No frame statistics in " << report << std::endl;
+        return false;
+    }
+    bench.add("macro.frame", options.frames, toSummary(match, 1));
+    // pass names are free text, e.g. "point shadows"
+    std::regex pass("\"([^\"]+)\": \\{\"cpu_ms\": " + summary + ", \"gpu_ms\": " + summary + "\\}");
+    for (std::sregex_iterator it(json.begin(), json.end(), pass), end; it != end; ++it) {
+        bench.add("macro." + (*it)[1].str() + ".cpu", options.frames, toSummary(*it, 2));
+        bench.add("macro." + (*it)[1].str() + ".gpu", options.frames, toSummary(*it, 7));
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--out" && hasValue)
+            options.output = argv[++i];
+        else if (arg == "--compare" && hasValue)
+            options.baseline = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            options.threshold = std::atof(argv[++i]);
+        else if (arg == "--filter" && hasValue)
+            options.filter = argv[++i];
+        else if (arg == "--frames" && hasValue)
+            options.frames = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--size" && hasValue)
+            options.size = argv[++i];
+        else if (arg == "--renderer" && hasValue)
+            options.renderer = argv[++i];
+        else if (arg == "--no-macro")
+            options.macro = false;
+        else {
+            std::cout << "Unknown argument " << arg << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    glfwInit();
+    GLFWwindow *window = createContext();
+    if (window == nullptr) {
+        std::cout << "Failed to create a context!\n";
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        std::cout << "Failed to init GLAD\n";
+        glfwTerminate();
+        return EXIT_FAILURE;
+    }
+    StreamBuffer::loadExtensions((GLADloadproc)glfwGetProcAddress);
+    std::cout << "renderer: " << (const char *)glGetString(GL_RENDERER) << std::endl;
+
+    Bench bench(options.filter);
+    benchAssets(bench);
+    benchUniforms(bench);
+    benchTransforms(bench);
+    benchQueue(bench);
+    benchCulling(bench);
+
+    GLDeletionQueue::flush();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    bool ok = !options.macro || benchFrames(bench, options);
+
+    if (!bench.writeJson(options.output)) {
+        std::cout << "Failed to write " << options.output << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "results written to " << options.output << std::endl;
+
+    if (!options.baseline.empty()) {
+        std::map<std::string, double> baseline;
+        if (!Bench::loadBaseline(options.baseline, baseline)) {
+            std::cout << "Failed to read baseline " << options.baseline << std::endl;
+            return EXIT_FAILURE;
+        }
+        unsigned int regressions = bench.compare(baseline, options.threshold);
+        std::cout << regressions << " regression(s) over " << options.threshold << "%" << std::endl;
+        if (regressions > 0)
+            return EXIT_FAILURE;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
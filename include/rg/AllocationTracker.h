@@ -0,0 +1,135 @@
+//
+// Counts heap allocations per thread, to check that the frame loops stop
+// allocating once they are warmed up. The global operator new in main.cpp
+// reports every C++ allocation here; while tracking is off that costs one
+// branch. Memory that C libraries and the GL driver get from malloc directly
+// is not seen, so a clean report covers the program's own code only.
+//
+// A loop brackets each frame with beginFrame/endFrame. Frames after the warmup
+// that the loop calls steady are expected to allocate nothing: REPORT prints
+// the ones that did, ABORT stops inside operator new at the first offending
+// allocation, so a debugger shows the call stack that made it.
+//
+
+#ifndef PROJECT_BASE_ALLOCATIONTRACKER_H
+#define PROJECT_BASE_ALLOCATIONTRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+class AllocationTracker {
+public:
+    enum Mode {
+        OFF,
+        REPORT,
+        ABORT
+    };
+
+    // frames at the start of a loop that may allocate, while pools and arenas grow
+    static const unsigned long WARMUP_FRAMES = 120;
+
+private:
+    struct Counters {
+        unsigned long count;
+        unsigned long bytes;
+        unsigned long frames;
+        unsigned long steadyFrames;
+        unsigned long allocatingFrames;
+        unsigned long steadyAllocations;
+        bool steady;
+        bool paused;
+    };
+
+    static std::atomic<int> &modeFlag() {
+        static std::atomic<int> mode{OFF};
+        return mode;
+    }
+
+    // constant-initialized, so the first use on a thread does not allocate
+    static Counters &counters() {
+        static thread_local Counters counters = {};
+        return counters;
+    }
+
+    // the tracker's own output is not counted
+    class Pause {
+        Counters &m_Counters;
+
+    public:
+        explicit Pause(Counters &counters) : m_Counters(counters) {
+            m_Counters.paused = true;
+        }
+
+        ~Pause() {
+            m_Counters.paused = false;
+        }
+    };
+
+public:
+    static void setMode(Mode mode) {
+        modeFlag().store(mode, std::memory_order_relaxed);
+    }
+
+    static Mode mode() {
+        return (Mode)modeFlag().load(std::memory_order_relaxed);
+    }
+
+    static bool enabled() {
+        return mode() != OFF;
+    }
+
+    // called from operator new
+    static void record(size_t bytes) {
+        Mode current = mode();
+        if (current == OFF)
+            return;
+        Counters &c = counters();
+        if (c.paused)
+            return;
+        c.count++;
+        c.bytes += bytes;
+        if (c.steady && current == ABORT) {
+            std::fprintf(stderr, "heap allocation of %zu bytes in steady frame %lu\n", bytes, c.frames);
+            std::abort();
+        }
+    }
+
+    // steady is false for frames that are allowed to allocate, e.g. after a resize or a key command
+    static void beginFrame(bool steady) {
+        Counters &c = counters();
+        c.count = 0;
+        c.bytes = 0;
+        c.steady = enabled() && steady && c.frames >= WARMUP_FRAMES;
+    }
+
+    static void endFrame(const char *loop) {
+        Counters &c = counters();
+        if (c.steady) {
+            c.steadyFrames++;
+            if (c.count > 0) {
+                c.allocatingFrames++;
+                c.steadyAllocations += c.count;
+                Pause pause(c);
+                std::cout << loop << " frame " << c.frames << ": " << c.count << " heap allocations, " << c.bytes
+                          << " bytes" << std::endl;
+            }
+        }
+        c.steady = false;
+        c.frames++;
+    }
+
+    // totals of the calling thread's loop
+    static void summary(const char *loop) {
+        if (!enabled())
+            return;
+        Counters &c = counters();
+        Pause pause(c);
+        std::cout << loop << ": " << c.allocatingFrames << " of " << c.steadyFrames
+                  << " steady frames allocated, " << c.steadyAllocations << " allocations in total" << std::endl;
+    }
+};
+
+#endif //PROJECT_BASE_ALLOCATIONTRACKER_H
@@ -0,0 +1,164 @@
+//
+// Downsample/upsample mip-chain bloom. The bright-pass image is filtered down a
+// chain of progressively halved targets with a 13-tap kernel and accumulated
+// back up with a tent filter, so every level only touches a fraction of the
+// full-resolution texels.
+//
+
+#ifndef PROJECT_BASE_BLOOM_H
+#define PROJECT_BASE_BLOOM_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLHandle.h>
+#include <rg/Shader.h>
+
+class Bloom {
+    struct Mip {
+        GLTexture texture;
+        int width, height;
+    };
+
+    Shader m_Down;
+    Shader m_Up;
+    GLFramebuffer m_Fbo;
+    std::vector<Mip> m_Mips;
+    unsigned int m_Levels;
+    int m_Width = 0, m_Height = 0;
+    float m_FilterRadius = 0.005f;
+
+    void release() {
+        // the chain may still be in flight, the handles hand the textures to the deletion queue
+        m_Mips.clear();
+    }
+
+    void allocate() {
+        release();
+        int width = m_Width, height = m_Height;
+        for (unsigned int i = 0; i < m_Levels; i++) {
+            width /= 2;
+            height /= 2;
+            if (width < 1 || height < 1)
+                break;
+
+            Mip mip;
+            mip.width = width;
+            mip.height = height;
+            GL_MEMORY_OWNER("bloom");
+            mip.texture = GLTexture::create();
+            glBindTexture(GL_TEXTURE_2D, mip.texture.get());
+            // 4 bytes per texel instead of the 8 of RGBA16F, bloom needs no alpha
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            m_Mips.push_back(std::move(mip));
+        }
+    }
+
+public:
+    Bloom(unsigned int levels, int width, int height)
+            : m_Down("resources/shaders/bloom.vs", "resources/shaders/bloom_down.fs"),
+              m_Up("resources/shaders/bloom.vs", "resources/shaders/bloom_up.fs"),
+              m_Levels(levels), m_Width(width), m_Height(height) {
+        GL_MEMORY_OWNER("bloom");
+        m_Fbo = GLFramebuffer::create();
+        m_Down.use();
+        m_Down.setInt("srcTexture", 0);
+        m_Up.use();
+        m_Up.setInt("srcTexture", 0);
+        allocate();
+    }
+
+    Bloom(const Bloom &) = delete;
+    Bloom &operator=(const Bloom &) = delete;
+
+    ~Bloom() {
+        m_Down.deleteProgram();
+        m_Up.deleteProgram();
+    }
+
+    // targets are only reallocated when the level count or source size actually changes
+    void setLevels(unsigned int levels) {
+        if (levels == m_Levels)
+            return;
+        m_Levels = levels;
+        allocate();
+    }
+
+    void resize(int width, int height) {
+        if (width == m_Width && height == m_Height)
+            return;
+        m_Width = width;
+        m_Height = height;
+        allocate();
+    }
+
+    unsigned int levels() const {
+        return m_Levels;
+    }
+
+    void setFilterRadius(float radius) {
+        m_FilterRadius = radius;
+    }
+
+    // blooms srcTexture and returns the half-resolution result texture; quadVAO is a
+    // full-screen triangle strip. Leaves the default framebuffer bound.
+    unsigned int render(unsigned int srcTexture, unsigned int quadVAO) {
+        if (m_Mips.empty())
+            return srcTexture;
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo.get());
+        glBindVertexArray(quadVAO);
+        glActiveTexture(GL_TEXTURE0);
+
+        // downsample: src -> mip0 -> mip1 -> ...
+        glDisable(GL_BLEND);
+        m_Down.use();
+        glBindTexture(GL_TEXTURE_2D, srcTexture);
+        for (auto &mip : m_Mips) {
+            glViewport(0, 0, mip.width, mip.height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture.get(), 0);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindTexture(GL_TEXTURE_2D, mip.texture.get());
+        }
+
+        // upsample: each level is tent-filtered and added onto the next larger one
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        m_Up.use();
+        m_Up.setFloat("filterRadius", m_FilterRadius);
+        for (size_t i = m_Mips.size() - 1; i > 0; i--) {
+            const Mip &mip = m_Mips[i - 1];
+            glBindTexture(GL_TEXTURE_2D, m_Mips[i].texture.get());
+            glViewport(0, 0, mip.width, mip.height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture.get(), 0);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        return m_Mips[0].texture.get();
+    }
+
+    // the texture render() writes its result to; changes when the chain is reallocated
+    unsigned int output() const {
+        return m_Mips.empty() ? 0 : m_Mips[0].texture.get();
+    }
+
+    // every level is summed into mip0 on the way up, this brings the result back to the input's range
+    float strength() const {
+        return m_Mips.empty() ? 1.0f : 1.0f / m_Mips.size();
+    }
+};
+
+#endif //PROJECT_BASE_BLOOM_H
@@ -81,6 +81,14 @@ public:
         updateCameraVectors();
     }
 
+    // places the camera directly, for scripted and replayed views
+    void SetPose(glm::vec3 position, float yaw, float pitch) {
+        Position = position;
+        Yaw = yaw;
+        Pitch = pitch;
+        updateCameraVectors();
+    }
+
     void ProcessMouseScroll(float yoffset) {
         Zoom -= yoffset;
         if (Zoom < 1.0f) {
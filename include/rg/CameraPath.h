@@ -0,0 +1,165 @@
+//
+// Recorded camera flight: a pose per simulation tick plus the key events that
+// happened in between, all stamped with simulation time. Replayed one tick per
+// frame it reproduces exactly the same views and toggles on any machine.
+//
+// The file is plain text, one record per line:
+//   pose <time> <x> <y> <z> <yaw> <pitch> <zoom>
+//   key <time> <key> <action>
+//
+
+#ifndef PROJECT_BASE_CAMERAPATH_H
+#define PROJECT_BASE_CAMERAPATH_H
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+class CameraPath {
+public:
+    struct Pose {
+        double time;
+        glm::vec3 position;
+        float yaw;
+        float pitch;
+        float zoom;
+    };
+
+    struct KeyEvent {
+        double time;
+        int key;
+        int action;
+    };
+
+private:
+    std::vector<Pose> m_Poses;
+    std::vector<KeyEvent> m_Events;
+    size_t m_NextEvent = 0;
+    std::vector<int> m_HeldKeys;
+
+public:
+    void clear() {
+        m_Poses.clear();
+        m_Events.clear();
+        rewind();
+    }
+
+    void addPose(const Pose &pose) {
+        m_Poses.push_back(pose);
+    }
+
+    void addKey(double time, int key, int action) {
+        m_Events.push_back(KeyEvent{time, key, action});
+    }
+
+    bool empty() const {
+        return m_Poses.empty();
+    }
+
+    double duration() const {
+        return m_Poses.empty() ? 0.0 : m_Poses.back().time;
+    }
+
+    size_t poseCount() const {
+        return m_Poses.size();
+    }
+
+    // pose at the given time, linear between the recorded ticks and clamped at the ends
+    Pose sample(double time) const {
+        if (m_Poses.empty())
+            return Pose{time, glm::vec3(0.0f), -90.0f, 0.0f, 45.0f};
+        auto next = std::lower_bound(m_Poses.begin(), m_Poses.end(), time,
+                                     [](const Pose &pose, double t) { return pose.time < t; });
+        if (next == m_Poses.begin())
+            return m_Poses.front();
+        if (next == m_Poses.end())
+            return m_Poses.back();
+        const Pose &previous = *(next - 1);
+        float t = (float)((time - previous.time) / (next->time - previous.time));
+        return Pose{time, glm::mix(previous.position, next->position, t), glm::mix(previous.yaw, next->yaw, t),
+                    glm::mix(previous.pitch, next->pitch, t), glm::mix(previous.zoom, next->zoom, t)};
+    }
+
+    void rewind() {
+        m_NextEvent = 0;
+        m_HeldKeys.clear();
+    }
+
+    // hands over every key event up to and including time, in recorded order
+    template <typename Callback>
+    void replayKeys(double time, Callback callback) {
+        for (; m_NextEvent < m_Events.size() && m_Events[m_NextEvent].time <= time; m_NextEvent++) {
+            const KeyEvent &event = m_Events[m_NextEvent];
+            auto held = std::find(m_HeldKeys.begin(), m_HeldKeys.end(), event.key);
+            if (event.action != 0 && held == m_HeldKeys.end())
+                m_HeldKeys.push_back(event.key);
+            else if (event.action == 0 && held != m_HeldKeys.end())
+                m_HeldKeys.erase(held);
+            callback(event.key, event.action);
+        }
+    }
+
+    // keys the replayed events left down
+    const std::vector<int> &heldKeys() const {
+        return m_HeldKeys;
+    }
+
+    // whether a replayed key is down, for input that is polled rather than handled in callbacks
+    bool keyDown(int key) const {
+        return std::find(m_HeldKeys.begin(), m_HeldKeys.end(), key) != m_HeldKeys.end();
+    }
+
+    bool save(const std::string &path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        // times must read back as the exact tick times they were stamped with, or replayed keys land a tick late
+        out.precision(std::numeric_limits<double>::max_digits10);
+        size_t event = 0;
+        // events are interleaved with the poses so the file reads in time order
+        for (const Pose &pose : m_Poses) {
+            for (; event < m_Events.size() && m_Events[event].time <= pose.time; event++)
+                out << "key " << m_Events[event].time << " " << m_Events[event].key << " " << m_Events[event].action << "\n";
+            out << "pose " << pose.time << " " << pose.position.x << " " << pose.position.y << " " << pose.position.z
+                << " " << pose.yaw << " " << pose.pitch << " " << pose.zoom << "\n";
+        }
+        for (; event < m_Events.size(); event++)
+            out << "key " << m_Events[event].time << " " << m_Events[event].key << " " << m_Events[event].action << "\n";
+        return true;
+    }
+
+    bool load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        clear();
+        std::string line;
+        while (std::getline(in, line)) {
+            std::istringstream fields(line);
+            std::string type;
+            fields >> type;
+            if (type == "pose") {
+                Pose pose;
+                fields >> pose.time >> pose.position.x >> pose.position.y >> pose.position.z
+                       >> pose.yaw >> pose.pitch >> pose.zoom;
+                if (fields)
+                    m_Poses.push_back(pose);
+            }
+            else if (type == "key") {
+                KeyEvent event;
+                fields >> event.time >> event.key >> event.action;
+                if (fields)
+                    m_Events.push_back(event);
+            }
+        }
+        // replay tracks held keys without allocating; there are never more than events
+        m_HeldKeys.reserve(m_Events.size());
+        return !m_Poses.empty();
+    }
+};
+
+#endif //PROJECT_BASE_CAMERAPATH_H
@@ -7,23 +7,32 @@
 #include <glad/glad.h>
 #include <stb_image.h>
 #include <rg/Error.h>
+#include <rg/GLHandle.h>
+#include <rg/GLMemory.h>
+#include <rg/Profiler.h>
 #include <vector>
 
 using namespace std;
 
 class Cubemap2D {
-    unsigned int w_Id;
+    GLTexture w_Texture;
 public:
     Cubemap2D(vector<std::string> faces) {
-        unsigned int tex;
-        glGenTextures(1, &tex);
+        GL_MEMORY_OWNER("skybox");
+        w_Texture = GLTexture::create();
+        unsigned int tex = w_Texture.get();
         glBindTexture(GL_TEXTURE_CUBE_MAP, tex);
 
         int width, height, nChannel;
         stbi_set_flip_vertically_on_load(true);
         for (unsigned int i = 0; i < faces.size(); i++) {
-            unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nChannel, 0);
+            unsigned char *data;
+            {
+                PROFILE_SCOPE("texture decode");
+                data = stbi_load(faces[i].c_str(), &width, &height, &nChannel, 0);
+            }
             if (data) {
+                PROFILE_SCOPE("texture upload");
                 glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
                 stbi_image_free(data);
             }
@@ -38,13 +47,14 @@ public:
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-
-        w_Id = tex;
     }
     void active(GLenum e) {
         glActiveTexture(e);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, w_Id);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, w_Texture.get());
+    }
+
+    unsigned int id() const {
+        return w_Texture.get();
     }
 
 };
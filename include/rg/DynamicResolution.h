@@ -0,0 +1,92 @@
+//
+// Picks the internal render resolution from the measured GPU frame time so the
+// scene stays within a frame-time budget. The scale is quantized and only moves
+// after the timer has caught up with the previous change, so render targets are
+// reallocated rarely.
+//
+
+#ifndef PROJECT_BASE_DYNAMICRESOLUTION_H
+#define PROJECT_BASE_DYNAMICRESOLUTION_H
+
+#include <cmath>
+#include <algorithm>
+
+class DynamicResolution {
+    float m_TargetMs;
+    float m_MinScale;
+    float m_MaxScale;
+    float m_Step = 0.05f;
+    float m_Scale;
+    double m_GpuMs = 0.0;
+    bool m_Enabled = true;
+    // GPU timings arrive a few frames late, wait that long after every change
+    unsigned int m_Cooldown = 0;
+    static const unsigned int SETTLE_FRAMES = 8;
+
+public:
+    DynamicResolution(float targetMs, float minScale = 0.5f, float maxScale = 1.0f)
+            : m_TargetMs(targetMs), m_MinScale(minScale), m_MaxScale(maxScale), m_Scale(maxScale) {
+    }
+
+    // feeds the latest GPU frame time, returns true when the scale changed
+    bool update(double gpuMs) {
+        m_GpuMs = gpuMs;
+        if (!m_Enabled || gpuMs <= 0.0)
+            return false;
+        if (m_Cooldown > 0) {
+            m_Cooldown--;
+            return false;
+        }
+
+        // cost is roughly proportional to pixel count, i.e. to scale squared;
+        // inside the +-10% band around the target nothing changes
+        double ratio = m_TargetMs / gpuMs;
+        if (ratio > 0.9 && ratio < 1.1)
+            return false;
+
+        float wanted = m_Scale * (float)std::sqrt(ratio);
+        // move at most two steps at a time and snap to the step grid
+        wanted = std::max(m_Scale - 2 * m_Step, std::min(m_Scale + 2 * m_Step, wanted));
+        wanted = std::round(wanted / m_Step) * m_Step;
+        wanted = std::max(m_MinScale, std::min(m_MaxScale, wanted));
+        if (std::fabs(wanted - m_Scale) < m_Step * 0.5f)
+            return false;
+
+        m_Scale = wanted;
+        m_Cooldown = SETTLE_FRAMES;
+        return true;
+    }
+
+    void setEnabled(bool enabled) {
+        m_Enabled = enabled;
+        if (!enabled)
+            m_Scale = m_MaxScale;
+        m_Cooldown = SETTLE_FRAMES;
+    }
+
+    bool enabled() const {
+        return m_Enabled;
+    }
+
+    void setTargetMs(float targetMs) {
+        m_TargetMs = targetMs;
+    }
+
+    float targetMs() const {
+        return m_TargetMs;
+    }
+
+    float scale() const {
+        return m_Scale;
+    }
+
+    double gpuMs() const {
+        return m_GpuMs;
+    }
+
+    int scaled(int size) const {
+        return std::max(1, (int)(size * m_Scale + 0.5f));
+    }
+};
+
+#endif //PROJECT_BASE_DYNAMICRESOLUTION_H
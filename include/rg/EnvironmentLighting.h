@@ -0,0 +1,323 @@
+//
+// Image based lighting from the skybox: a diffuse irradiance cube, a specular
+// cube prefiltered for increasing roughness down its mip chain and the split
+// sum BRDF lookup table, all convolved on the GPU.
+//
+// The convolution only runs when the cache has no entry for this skybox. Cache
+// files are named by an FNV-1a hash of the face images and the map sizes, so a
+// changed face or a new convolution version simply misses; a hit uploads the
+// stored half-float texels and compiles no shaders at all.
+//
+
+#ifndef PROJECT_BASE_ENVIRONMENTLIGHTING_H
+#define PROJECT_BASE_ENVIRONMENTLIGHTING_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/Profiler.h>
+#include <rg/Shader.h>
+
+class EnvironmentLighting {
+public:
+    static const int IRRADIANCE_SIZE = 32;
+    static const int PREFILTER_SIZE = 128;
+    static const int PREFILTER_MIPS = 5;
+    static const int BRDF_SIZE = 128;
+    // bump whenever the convolution shaders change, old cache files then stop matching
+    static const uint32_t VERSION = 1;
+
+private:
+    struct CacheHeader {
+        char magic[8];
+        uint32_t version;
+        int32_t irradianceSize;
+        int32_t prefilterSize;
+        int32_t prefilterMips;
+        int32_t brdfSize;
+    };
+
+    GLTexture m_Irradiance;
+    GLTexture m_Prefilter;
+    GLTexture m_Brdf;
+    std::string m_CachePath;
+    bool m_FromCache = false;
+    double m_BuildMs = 0.0;
+
+    static uint64_t fnv1a(uint64_t hash, const void *data, size_t size) {
+        const unsigned char *bytes = (const unsigned char *)data;
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static uint64_t hashInputs(const std::vector<std::string> &faces) {
+        uint64_t hash = 14695981039346656037ull;
+        const int32_t parameters[] = {(int32_t)VERSION, IRRADIANCE_SIZE, PREFILTER_SIZE, PREFILTER_MIPS, BRDF_SIZE};
+        hash = fnv1a(hash, parameters, sizeof(parameters));
+        std::vector<char> buffer(64 * 1024);
+        for (const std::string &face : faces) {
+            std::ifstream in(face, std::ios::binary);
+            while (in) {
+                in.read(buffer.data(), buffer.size());
+                hash = fnv1a(hash, buffer.data(), (size_t)in.gcount());
+            }
+        }
+        return hash;
+    }
+
+    static GLTexture createCube(int size, int mips, GLenum internalFormat) {
+        GLTexture texture = GLTexture::create();
+        glBindTexture(GL_TEXTURE_CUBE_MAP, texture.get());
+        for (int mip = 0; mip < mips; mip++)
+            for (unsigned int face = 0; face < 6; face++)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip, internalFormat, size >> mip, size >> mip, 0,
+                             GL_RGB, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mips > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, mips - 1);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    void allocate() {
+        GL_MEMORY_OWNER("environment lighting");
+        m_Irradiance = createCube(IRRADIANCE_SIZE, 1, GL_RGB16F);
+        m_Prefilter = createCube(PREFILTER_SIZE, PREFILTER_MIPS, GL_RGB16F);
+        m_Brdf = GLTexture::create();
+        glBindTexture(GL_TEXTURE_2D, m_Brdf.get());
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BRDF_SIZE, BRDF_SIZE, 0, GL_RG, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        GLDebug::label(GL_TEXTURE, m_Irradiance.get(), "irradiance");
+        GLDebug::label(GL_TEXTURE, m_Prefilter.get(), "prefiltered environment");
+        GLDebug::label(GL_TEXTURE, m_Brdf.get(), "brdf lut");
+    }
+
+    // the texture levels in the order they are stored in a cache file
+    template <typename Level>
+    void forEachLevel(Level level) {
+        for (unsigned int face = 0; face < 6; face++)
+            level(GL_TEXTURE_CUBE_MAP, m_Irradiance.get(), GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, IRRADIANCE_SIZE, GL_RGB, 3);
+        for (int mip = 0; mip < PREFILTER_MIPS; mip++)
+            for (unsigned int face = 0; face < 6; face++)
+                level(GL_TEXTURE_CUBE_MAP, m_Prefilter.get(), GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, mip,
+                      PREFILTER_SIZE >> mip, GL_RGB, 3);
+        level(GL_TEXTURE_2D, m_Brdf.get(), GL_TEXTURE_2D, 0, BRDF_SIZE, GL_RG, 2);
+    }
+
+    static CacheHeader header() {
+        CacheHeader h;
+        std::memcpy(h.magic, "SPACEIBL", 8);
+        h.version = VERSION;
+        h.irradianceSize = IRRADIANCE_SIZE;
+        h.prefilterSize = PREFILTER_SIZE;
+        h.prefilterMips = PREFILTER_MIPS;
+        h.brdfSize = BRDF_SIZE;
+        return h;
+    }
+
+    bool load() {
+        PROFILE_SCOPE("ibl cache load");
+        std::ifstream in(m_CachePath, std::ios::binary);
+        if (!in)
+            return false;
+        CacheHeader expected = header(), stored;
+        in.read((char *)&stored, sizeof(stored));
+        if (!in || std::memcmp(&stored, &expected, sizeof(stored)) != 0)
+            return false;
+
+        std::vector<uint16_t> texels;
+        bool complete = true;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        forEachLevel([&](GLenum target, unsigned int texture, GLenum image, int mip, int size, GLenum format, int channels) {
+            texels.resize((size_t)size * size * channels);
+            in.read((char *)texels.data(), texels.size() * sizeof(uint16_t));
+            complete = complete && (bool)in;
+            glBindTexture(target, texture);
+            glTexSubImage2D(image, mip, 0, 0, size, size, format, GL_HALF_FLOAT, texels.data());
+        });
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        return complete;
+    }
+
+    void save() {
+        PROFILE_SCOPE("ibl cache save");
+        size_t slash = m_CachePath.find_last_of('/');
+        if (slash != std::string::npos)
+            mkdir(m_CachePath.substr(0, slash).c_str(), 0755);
+        // written under a temporary name, so an interrupted run never leaves a truncated hit behind
+        std::string temporary = m_CachePath + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+            return;
+        CacheHeader h = header();
+        out.write((const char *)&h, sizeof(h));
+
+        std::vector<uint16_t> texels;
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        forEachLevel([&](GLenum target, unsigned int texture, GLenum image, int mip, int size, GLenum format, int channels) {
+            texels.resize((size_t)size * size * channels);
+            glBindTexture(target, texture);
+            glGetTexImage(image, mip, format, GL_HALF_FLOAT, texels.data());
+            out.write((const char *)texels.data(), texels.size() * sizeof(uint16_t));
+        });
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        out.close();
+        if (out)
+            std::rename(temporary.c_str(), m_CachePath.c_str());
+        else
+            std::remove(temporary.c_str());
+    }
+
+    void convolve(unsigned int skybox, unsigned int cubeVAO, unsigned int quadVAO) {
+        PROFILE_SCOPE("ibl convolution");
+        Shader irradiance("resources/shaders/ibl_cube.vs", "resources/shaders/irradiance.fs");
+        Shader prefilter("resources/shaders/ibl_cube.vs", "resources/shaders/prefilter.fs");
+        Shader brdf("resources/shaders/bloom.vs", "resources/shaders/brdf.fs");
+
+        const glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 10.0f);
+        const glm::mat4 views[6] = {
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, -1.0f, 0.0f)),
+                glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, -1.0f, 0.0f))};
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+        GLboolean blend = glIsEnabled(GL_BLEND);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_BLEND);
+
+        // source mips for the prefilter's per-sample level, only for the duration of the convolution
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skybox);
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        GLint skyboxSize = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &skyboxSize);
+
+        GL_MEMORY_OWNER("environment lighting");
+        GLFramebuffer fbo = GLFramebuffer::create();
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo.get());
+        glBindVertexArray(cubeVAO);
+
+        irradiance.use();
+        irradiance.setInt("environmentMap", 0);
+        irradiance.setMat4("projection", projection);
+        glViewport(0, 0, IRRADIANCE_SIZE, IRRADIANCE_SIZE);
+        for (unsigned int face = 0; face < 6; face++) {
+            irradiance.setMat4("view", views[face]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_Irradiance.get(), 0);
+            glDrawArrays(GL_TRIANGLES, 0, 36);
+        }
+
+        prefilter.use();
+        prefilter.setInt("environmentMap", 0);
+        prefilter.setMat4("projection", projection);
+        prefilter.setFloat("resolution", (float)skyboxSize);
+        for (int mip = 0; mip < PREFILTER_MIPS; mip++) {
+            glViewport(0, 0, PREFILTER_SIZE >> mip, PREFILTER_SIZE >> mip);
+            prefilter.setFloat("roughness", (float)mip / (float)(PREFILTER_MIPS - 1));
+            for (unsigned int face = 0; face < 6; face++) {
+                prefilter.setMat4("view", views[face]);
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, m_Prefilter.get(), mip);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            }
+        }
+
+        brdf.use();
+        glViewport(0, 0, BRDF_SIZE, BRDF_SIZE);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Brdf.get(), 0);
+        glBindVertexArray(quadVAO);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, skybox);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+        if (cullFace)
+            glEnable(GL_CULL_FACE);
+        if (blend)
+            glEnable(GL_BLEND);
+
+        irradiance.deleteProgram();
+        prefilter.deleteProgram();
+        brdf.deleteProgram();
+    }
+
+public:
+    // skybox is the cube map built from faces; cubeVAO draws a 36 vertex unit cube,
+    // quadVAO a full-screen triangle strip
+    EnvironmentLighting(unsigned int skybox, const std::vector<std::string> &faces, unsigned int cubeVAO,
+                        unsigned int quadVAO, const std::string &cacheDirectory = "cache") {
+        auto start = std::chrono::steady_clock::now();
+        char name[32];
+        std::snprintf(name, sizeof(name), "ibl_%016llx.bin", (unsigned long long)hashInputs(faces));
+        m_CachePath = cacheDirectory + "/" + name;
+
+        // lets the small prefiltered mips filter across face edges, for every cube map sampled from now on
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        allocate();
+        m_FromCache = load();
+        if (!m_FromCache) {
+            convolve(skybox, cubeVAO, quadVAO);
+            save();
+        }
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        m_BuildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    EnvironmentLighting(const EnvironmentLighting &) = delete;
+    EnvironmentLighting &operator=(const EnvironmentLighting &) = delete;
+
+    void bind(GLenum irradianceUnit, GLenum prefilterUnit, GLenum brdfUnit) const {
+        glActiveTexture(irradianceUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_Irradiance.get());
+        glActiveTexture(prefilterUnit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_Prefilter.get());
+        glActiveTexture(brdfUnit);
+        glBindTexture(GL_TEXTURE_2D, m_Brdf.get());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    bool fromCache() const {
+        return m_FromCache;
+    }
+
+    const std::string &cachePath() const {
+        return m_CachePath;
+    }
+
+    // load or convolution time, including the hash of the face images
+    double buildMs() const {
+        return m_BuildMs;
+    }
+};
+
+#endif //PROJECT_BASE_ENVIRONMENTLIGHTING_H
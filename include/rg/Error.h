@@ -11,12 +11,24 @@
 #define LOG(stream) stream << "[" << __FILE__ << ", " << __func__ << ", " << __LINE__ << "] "
 #define BREAK_IF_FALSE(x) if (!(x)) __builtin_trap()
 #define ASSERT(x, msg) do { if (!(x)) { std::cerr << msg << '\n'; BREAK_IF_FALSE(false); } } while(0)
+#ifndef SPACE_GL_CHECKS
+#define SPACE_GL_CHECKS 1
+#endif
+// with KHR_debug active the driver reports errors itself (see rg/GLDebug.h), glGetError is only the fallback
+#if SPACE_GL_CHECKS
 #define GLCALL(x) \
-do{ rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } while (0)
+do{ if (rg::debugOutputEnabled()) { x; } else { rg::clearAllOpenGlErrors(); x; BREAK_IF_FALSE(rg::wasPreviousOpenGLCallSuccessful(__FILE__, __LINE__, #x)); } } while (0)
+#else
+#define GLCALL(x) do { x; } while (0)
+#endif
 
 namespace rg {
 
-    
+    inline bool &debugOutputEnabled() {
+        static bool enabled = false;
+        return enabled;
+    }
+
 void clearAllOpenGlErrors();
 const char* openGLErrorToString(GLenum error);
 bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call);
@@ -32,10 +44,11 @@ bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* cal
             case GL_INVALID_ENUM: return "GL_INVALID_ENUM";
             case GL_INVALID_VALUE: return "GL_INVALID_VALUE";
             case GL_INVALID_OPERATION: return "GL_INVALID_OPERATION";
+            case GL_INVALID_FRAMEBUFFER_OPERATION: return "GL_INVALID_FRAMEBUFFER_OPERATION";
             case GL_OUT_OF_MEMORY: return "GL_OUT_OF_MEMORY";
         }
-        ASSERT(false, "Passed something that is not an error code");
-        return "THIS_SHOULD_NEVER_HAPPEN";
+        // drivers and extensions may report codes this list does not know
+        return "unknown GL error";
     }
     bool wasPreviousOpenGLCallSuccessful(const char* file, int line, const char* call) {
         bool success = true;
@@ -0,0 +1,51 @@
+//
+// Fixed-rate simulation clock. Real frame time is accumulated and consumed in
+// whole ticks of 1/rate seconds; what is left over gives the blend factor
+// between the last two ticks for rendering.
+//
+
+#ifndef PROJECT_BASE_FIXEDTIMESTEP_H
+#define PROJECT_BASE_FIXEDTIMESTEP_H
+
+class FixedTimestep {
+    double m_Step;
+    double m_Accumulator = 0.0;
+    double m_Time = 0.0;
+    // a frame that took longer than this many ticks drops the rest instead of
+    // running ever more ticks to catch up
+    static const unsigned int MAX_TICKS_PER_FRAME = 8;
+
+public:
+    explicit FixedTimestep(double rate) : m_Step(1.0 / rate) {
+    }
+
+    double step() const {
+        return m_Step;
+    }
+
+    // adds a frame's real time, returns how many ticks to simulate for it
+    unsigned int advance(double frameSeconds) {
+        m_Accumulator += frameSeconds;
+        unsigned int ticks = 0;
+        while (m_Accumulator >= m_Step && ticks < MAX_TICKS_PER_FRAME) {
+            m_Accumulator -= m_Step;
+            m_Time += m_Step;
+            ticks++;
+        }
+        if (ticks == MAX_TICKS_PER_FRAME && m_Accumulator >= m_Step)
+            m_Accumulator = 0.0;
+        return ticks;
+    }
+
+    // simulation time of the latest tick
+    double time() const {
+        return m_Time;
+    }
+
+    // how far real time is between the previous tick (0) and the latest one (1)
+    float alpha() const {
+        return (float)(m_Accumulator / m_Step);
+    }
+};
+
+#endif //PROJECT_BASE_FIXEDTIMESTEP_H
@@ -0,0 +1,115 @@
+//
+// Linear allocator for data that lives for one frame. Allocating bumps an
+// offset and reset() forgets everything at once; nothing is freed one by one.
+// When a frame needs more than the buffer holds, the rest comes from extra
+// blocks and the next reset() replaces the buffer with one large enough, so
+// after the first frames the arena stops touching the heap.
+//
+// FrameFunction is the arena's std::function: the callable is stored in the
+// arena instead of on the heap. It is never destroyed, so only callables
+// without destructors are accepted, which lambdas capturing references and
+// plain values are.
+//
+
+#ifndef PROJECT_BASE_FRAMEARENA_H
+#define PROJECT_BASE_FRAMEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class FrameArena {
+    std::unique_ptr<unsigned char[]> m_Buffer;
+    size_t m_Capacity;
+    size_t m_Used = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> m_Overflow;
+    size_t m_OverflowBytes = 0;
+    size_t m_HighWater = 0;
+
+public:
+    explicit FrameArena(size_t capacity = 64 * 1024)
+            : m_Buffer(new unsigned char[capacity]), m_Capacity(capacity) {
+    }
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // align must be a power of two no larger than alignof(std::max_align_t)
+    void *allocate(size_t size, size_t align) {
+        size_t offset = (m_Used + align - 1) & ~(align - 1);
+        if (offset + size <= m_Capacity) {
+            m_Used = offset + size;
+            return m_Buffer.get() + offset;
+        }
+        m_Overflow.emplace_back(new unsigned char[size]);
+        m_OverflowBytes += size + align;
+        return m_Overflow.back().get();
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args &&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // everything allocated since the last reset is gone
+    void reset() {
+        m_HighWater = std::max(m_HighWater, m_Used + m_OverflowBytes);
+        if (!m_Overflow.empty()) {
+            m_Capacity = std::max(m_Capacity * 2, m_Used + m_OverflowBytes);
+            m_Buffer.reset(new unsigned char[m_Capacity]);
+            m_Overflow.clear();
+            m_OverflowBytes = 0;
+        }
+        m_Used = 0;
+    }
+
+    size_t capacity() const {
+        return m_Capacity;
+    }
+
+    // the most any frame has needed
+    size_t highWater() const {
+        return std::max(m_HighWater, m_Used + m_OverflowBytes);
+    }
+};
+
+template <typename Signature>
+class FrameFunction;
+
+template <typename R, typename... Args>
+class FrameFunction<R(Args...)> {
+    void *m_Callable = nullptr;
+    R (*m_Invoke)(void *, Args...) = nullptr;
+
+    template <typename Callable>
+    static R invoke(void *callable, Args... args) {
+        return (*static_cast<Callable *>(callable))(std::forward<Args>(args)...);
+    }
+
+public:
+    FrameFunction() = default;
+
+    // valid until the arena is reset
+    template <typename F>
+    FrameFunction(FrameArena &arena, F &&function) {
+        typedef typename std::decay<F>::type Callable;
+        static_assert(std::is_trivially_destructible<Callable>::value,
+                      "a frame function is never destroyed, its captures must not need destructors");
+        m_Callable = arena.create<Callable>(std::forward<F>(function));
+        m_Invoke = &FrameFunction::invoke<Callable>;
+    }
+
+    R operator()(Args... args) const {
+        return m_Invoke(m_Callable, std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const {
+        return m_Invoke != nullptr;
+    }
+};
+
+#endif //PROJECT_BASE_FRAMEARENA_H
@@ -0,0 +1,286 @@
+//
+// Records the finished frames to a raw Y4M video without stalling the GPU.
+// Each frame is read into one of a ring of pixel buffer objects and fenced;
+// the copy out of the buffer happens only once its fence has signalled, a few
+// frames later. Colour conversion and file writes run on worker threads, which
+// write frames strictly in order.
+//
+
+#ifndef PROJECT_BASE_FRAMECAPTURE_H
+#define PROJECT_BASE_FRAMECAPTURE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLHandle.h>
+#include <rg/GLMemory.h>
+
+class FrameCapture {
+    struct Slot {
+        GLBuffer pbo;
+        GLsync fence = nullptr;
+        uint64_t frame = 0;
+    };
+
+    struct Job {
+        uint64_t frame;
+        std::vector<unsigned char> rgba;
+    };
+
+    static const unsigned int SLOTS = 3;
+    // frames read back but not yet written; beyond this the render thread waits for the workers
+    static const unsigned int MAX_PENDING = 8;
+
+    Slot m_Slots[SLOTS];
+    unsigned int m_Head = 0;
+    int m_Width = 0;
+    int m_Height = 0;
+    uint64_t m_NextFrame = 0;
+    bool m_Recording = false;
+    unsigned long m_Waits = 0;
+
+    std::ofstream m_Out;
+    std::vector<std::thread> m_Workers;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobsChanged;
+    std::deque<Job> m_Jobs;
+    std::vector<std::vector<unsigned char>> m_FreeBuffers;
+    bool m_Stopping = false;
+
+    std::mutex m_WriteMutex;
+    std::condition_variable m_Written;
+    uint64_t m_NextWrite = 0;
+
+    size_t frameBytes() const {
+        return (size_t)m_Width * m_Height * 4;
+    }
+
+    // copies a finished readback out of its buffer and hands it to the workers
+    void retire(Slot &slot) {
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            m_Waits++;
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        std::vector<unsigned char> rgba;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            if (m_Jobs.size() >= MAX_PENDING) {
+                m_Waits++;
+                m_JobsChanged.wait(lock, [this]() { return m_Jobs.size() < MAX_PENDING; });
+            }
+            if (!m_FreeBuffers.empty()) {
+                rgba = std::move(m_FreeBuffers.back());
+                m_FreeBuffers.pop_back();
+            }
+        }
+        rgba.resize(frameBytes());
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo.get());
+        void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes(), GL_MAP_READ_BIT);
+        if (pixels != nullptr) {
+            std::memcpy(rgba.data(), pixels, frameBytes());
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jobs.push_back(Job{slot.frame, std::move(rgba)});
+        }
+        m_JobsChanged.notify_all();
+    }
+
+    bool signalled(const Slot &slot) const {
+        return glClientWaitSync(slot.fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+    }
+
+    // BT.601 limited range 4:2:0, rows flipped since GL reads bottom-up
+    void convert(const std::vector<unsigned char> &rgba, std::vector<unsigned char> &yuv) const {
+        int w = m_Width, h = m_Height;
+        yuv.resize((size_t)w * h * 3 / 2);
+        unsigned char *yPlane = yuv.data();
+        unsigned char *uPlane = yPlane + (size_t)w * h;
+        unsigned char *vPlane = uPlane + (size_t)w * h / 4;
+        for (int y = 0; y < h; y++) {
+            const unsigned char *row = &rgba[(size_t)(h - 1 - y) * w * 4];
+            for (int x = 0; x < w; x++) {
+                int r = row[x * 4], g = row[x * 4 + 1], b = row[x * 4 + 2];
+                yPlane[(size_t)y * w + x] = (unsigned char)((66 * r + 129 * g + 25 * b + 128) / 256 + 16);
+            }
+        }
+        for (int y = 0; y < h / 2; y++) {
+            const unsigned char *row0 = &rgba[(size_t)(h - 1 - 2 * y) * w * 4];
+            const unsigned char *row1 = &rgba[(size_t)(h - 2 - 2 * y) * w * 4];
+            for (int x = 0; x < w / 2; x++) {
+                int r = 0, g = 0, b = 0;
+                for (int i = 0; i < 2; i++) {
+                    r += row0[(2 * x + i) * 4] + row1[(2 * x + i) * 4];
+                    g += row0[(2 * x + i) * 4 + 1] + row1[(2 * x + i) * 4 + 1];
+                    b += row0[(2 * x + i) * 4 + 2] + row1[(2 * x + i) * 4 + 2];
+                }
+                r /= 4, g /= 4, b /= 4;
+                uPlane[(size_t)y * (w / 2) + x] = (unsigned char)((-38 * r - 74 * g + 112 * b + 128) / 256 + 128);
+                vPlane[(size_t)y * (w / 2) + x] = (unsigned char)((112 * r - 94 * g - 18 * b + 128) / 256 + 128);
+            }
+        }
+    }
+
+    void work() {
+        std::vector<unsigned char> yuv;
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_Mutex);
+                m_JobsChanged.wait(lock, [this]() { return m_Stopping || !m_Jobs.empty(); });
+                if (m_Jobs.empty())
+                    return;
+                job = std::move(m_Jobs.front());
+                m_Jobs.pop_front();
+            }
+            m_JobsChanged.notify_all();
+
+            convert(job.rgba, yuv);
+            {
+                std::unique_lock<std::mutex> lock(m_WriteMutex);
+                m_Written.wait(lock, [this, &job]() { return m_NextWrite == job.frame; });
+                m_Out << "FRAME\n";
+                m_Out.write((const char *)yuv.data(), yuv.size());
+                m_NextWrite++;
+            }
+            m_Written.notify_all();
+
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_FreeBuffers.push_back(std::move(job.rgba));
+        }
+    }
+
+public:
+    FrameCapture() = default;
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture &operator=(const FrameCapture &) = delete;
+
+    ~FrameCapture() {
+        stop();
+    }
+
+    // 4:2:0 needs even dimensions, an odd last row or column is left out
+    bool start(const std::string &path, int width, int height, int fps) {
+        stop();
+        m_Width = width & ~1;
+        m_Height = height & ~1;
+        if (m_Width <= 0 || m_Height <= 0)
+            return false;
+        m_Out.open(path, std::ios::binary);
+        if (!m_Out)
+            return false;
+        m_Out << "YUV4MPEG2 W" << m_Width << " H" << m_Height << " F" << fps << ":1 Ip A1:1 C420jpeg\n";
+
+        GL_MEMORY_OWNER("frame capture");
+        for (auto &slot : m_Slots) {
+            slot.pbo = GLBuffer::create();
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo.get());
+            glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes(), nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_Head = 0;
+        m_NextFrame = 0;
+        m_NextWrite = 0;
+        m_Waits = 0;
+        m_Stopping = false;
+        unsigned int workers = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+        for (unsigned int i = 0; i < workers; i++)
+            m_Workers.emplace_back(&FrameCapture::work, this);
+        m_Recording = true;
+        return true;
+    }
+
+    // writes out every frame still in flight
+    void stop() {
+        if (!m_Recording)
+            return;
+        for (unsigned int i = 0; i < SLOTS; i++) {
+            Slot &slot = m_Slots[(m_Head + i) % SLOTS];
+            if (slot.fence != nullptr)
+                retire(slot);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Stopping = true;
+        }
+        m_JobsChanged.notify_all();
+        for (auto &worker : m_Workers)
+            worker.join();
+        m_Workers.clear();
+        m_FreeBuffers.clear();
+        for (auto &slot : m_Slots)
+            slot.pbo.reset();
+        m_Out.close();
+        m_Recording = false;
+    }
+
+    bool recording() const {
+        return m_Recording;
+    }
+
+    int width() const {
+        return m_Width;
+    }
+
+    int height() const {
+        return m_Height;
+    }
+
+    // frames queued so far
+    uint64_t frames() const {
+        return m_NextFrame;
+    }
+
+    // times the render thread had to wait for a readback or for the workers
+    unsigned long waits() const {
+        return m_Waits;
+    }
+
+    // queues a readback of the bottom-left width x height of the bound read framebuffer
+    void capture() {
+        if (!m_Recording)
+            return;
+        Slot &slot = m_Slots[m_Head];
+        // the ring is full, the oldest readback has to be taken out first
+        if (slot.fence != nullptr)
+            retire(slot);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo.get());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, m_Width, m_Height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.frame = m_NextFrame++;
+        m_Head = (m_Head + 1) % SLOTS;
+
+        // hand over the older readbacks that are already done, oldest first
+        for (unsigned int i = 0; i < SLOTS - 1; i++) {
+            Slot &older = m_Slots[(m_Head + i) % SLOTS];
+            if (older.fence == nullptr)
+                continue;
+            if (!signalled(older))
+                break;
+            retire(older);
+        }
+    }
+};
+
+#endif //PROJECT_BASE_FRAMECAPTURE_H
@@ -0,0 +1,467 @@
+//
+// Frame graph for the render passes of a frame. Passes declare the textures they
+// read and write, the graph orders them, drops passes whose results nobody uses
+// and backs transient textures with a pool. Resources with the same size and
+// format whose lifetimes do not overlap may share a GL texture; in the current
+// graph no two qualify, so the pool mainly keeps targets alive across frames.
+// The pass callbacks live in a frame arena and all lists keep their storage,
+// so describing a frame does not allocate.
+//
+
+#ifndef PROJECT_BASE_FRAMEGRAPH_H
+#define PROJECT_BASE_FRAMEGRAPH_H
+
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/FrameArena.h>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/GpuProfiler.h>
+#include <rg/GpuTimer.h>
+#include <rg/Profiler.h>
+
+struct TextureDesc {
+    int width = 0;
+    int height = 0;
+    GLenum internalFormat = GL_RGBA16F;
+
+    TextureDesc() = default;
+    TextureDesc(int width, int height, GLenum internalFormat)
+            : width(width), height(height), internalFormat(internalFormat) {
+    }
+
+    bool operator==(const TextureDesc &other) const {
+        return width == other.width && height == other.height && internalFormat == other.internalFormat;
+    }
+
+    bool isDepth() const {
+        return internalFormat == GL_DEPTH_COMPONENT16 || internalFormat == GL_DEPTH_COMPONENT24 ||
+               internalFormat == GL_DEPTH_COMPONENT32F || internalFormat == GL_DEPTH_COMPONENT;
+    }
+
+    size_t bytes() const {
+        size_t texel = 4;
+        switch (internalFormat) {
+            case GL_RGBA32F: texel = 16; break;
+            case GL_RGBA16F: texel = 8; break;
+            case GL_RGB16F: texel = 6; break;
+            case GL_R16F: case GL_DEPTH_COMPONENT16: texel = 2; break;
+            case GL_R8: texel = 1; break;
+            default: texel = 4; break;
+        }
+        return texel * (size_t)width * (size_t)height;
+    }
+};
+
+// textures handed out to transient frame graph resources, reused only for an
+// identical TextureDesc. When a frame had to create a texture (e.g. after a
+// resolution change) everything it left idle is dropped at its end; otherwise a
+// texture goes once it has not been asked for in a while
+class RenderTargetPool {
+    struct Entry {
+        TextureDesc desc;
+        GLTexture texture;
+        unsigned long lastUsed;
+        bool busy;
+    };
+    std::vector<Entry> m_Entries;
+    unsigned long m_Frame = 0;
+    bool m_Created = false;
+    static const unsigned long EVICT_AFTER = 120;
+
+public:
+    RenderTargetPool() = default;
+    RenderTargetPool(const RenderTargetPool &) = delete;
+    RenderTargetPool &operator=(const RenderTargetPool &) = delete;
+
+    unsigned int acquire(const TextureDesc &desc) {
+        for (auto &entry : m_Entries) {
+            if (!entry.busy && entry.desc == desc) {
+                entry.busy = true;
+                entry.lastUsed = m_Frame;
+                return entry.texture.get();
+            }
+        }
+
+        Entry entry;
+        entry.desc = desc;
+        entry.busy = true;
+        entry.lastUsed = m_Frame;
+        GL_MEMORY_OWNER("render targets");
+        m_Created = true;
+        entry.texture = GLTexture::create();
+        glBindTexture(GL_TEXTURE_2D, entry.texture.get());
+        if (desc.isDepth())
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.internalFormat, desc.width, desc.height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        unsigned int texture = entry.texture.get();
+        m_Entries.push_back(std::move(entry));
+        return texture;
+    }
+
+    void release(unsigned int texture) {
+        for (auto &entry : m_Entries) {
+            if (entry.texture.get() == texture) {
+                entry.busy = false;
+                return;
+            }
+        }
+    }
+
+    void endFrame() {
+        m_Frame++;
+        // entries used this frame are 1 frame old now
+        unsigned long maxAge = m_Created ? 1 : EVICT_AFTER;
+        m_Created = false;
+        for (size_t i = 0; i < m_Entries.size();) {
+            if (!m_Entries[i].busy && m_Frame - m_Entries[i].lastUsed > maxAge) {
+                // frames still in flight may sample it, the handle defers the delete
+                m_Entries[i] = std::move(m_Entries.back());
+                m_Entries.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    size_t count() const {
+        return m_Entries.size();
+    }
+
+    size_t bytes() const {
+        size_t total = 0;
+        for (auto &entry : m_Entries)
+            total += entry.desc.bytes();
+        return total;
+    }
+};
+
+class FrameGraph {
+public:
+    typedef unsigned int Resource;
+    typedef FrameFunction<void(const FrameGraph &)> Execute;
+
+private:
+    static const unsigned int NONE = ~0u;
+
+    struct ResourceNode {
+        const char *name;
+        TextureDesc desc;
+        unsigned int texture;
+        bool imported;
+        bool backbuffer;
+        unsigned int readers;
+        unsigned int first, last;
+    };
+
+    struct PassNode {
+        const char *name;
+        Execute execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> writes;
+        // the pass binds its own framebuffers instead of rendering into its writes
+        bool manualTargets;
+        bool alive;
+        double cpuMs;
+        GpuTimer *timer;
+    };
+
+    RenderTargetPool &m_Pool;
+    FrameArena m_Arena;
+    std::vector<ResourceNode> m_Resources;
+    std::vector<PassNode> m_Passes;
+    // read and write lists of last frame's passes, handed to the next passes with their capacity
+    std::vector<std::vector<Resource>> m_SpareLists;
+    std::vector<unsigned int> m_Order;
+    std::vector<bool> m_Scheduled;
+    std::vector<GLFramebuffer> m_Fbos;
+    std::vector<unsigned int> m_FboColors;
+    // passes are described anew every frame, their timers stay, found by name;
+    // pass names are string literals, so the keys outlive the frame
+    std::vector<std::pair<const char *, std::unique_ptr<GpuTimer>>> m_Timers;
+    unsigned int m_Culled = 0;
+
+    static bool contains(const std::vector<Resource> &list, Resource r) {
+        for (Resource x : list)
+            if (x == r)
+                return true;
+        return false;
+    }
+
+    GpuTimer *timer(const char *name) {
+        for (auto &timer : m_Timers)
+            if (std::strcmp(timer.first, name) == 0)
+                return timer.second.get();
+        m_Timers.emplace_back(name, std::unique_ptr<GpuTimer>(new GpuTimer()));
+        return m_Timers.back().second.get();
+    }
+
+    void bindTargets(unsigned int slot, const PassNode &pass) {
+        const ResourceNode *size = nullptr;
+        for (Resource r : pass.writes) {
+            if (m_Resources[r].backbuffer) {
+                glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                glViewport(0, 0, m_Resources[r].desc.width, m_Resources[r].desc.height);
+                return;
+            }
+        }
+
+        GL_MEMORY_OWNER("render targets");
+        while (m_Fbos.size() <= slot) {
+            m_Fbos.push_back(GLFramebuffer::create());
+            m_FboColors.push_back(0);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbos[slot].get());
+
+        GLenum drawBuffers[8];
+        unsigned int colors = 0;
+        bool depth = false;
+        for (Resource r : pass.writes) {
+            const ResourceNode &res = m_Resources[r];
+            if (res.desc.isDepth()) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, res.texture, 0);
+                depth = true;
+            } else if (colors < 8) {
+                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + colors, GL_TEXTURE_2D, res.texture, 0);
+                drawBuffers[colors] = GL_COLOR_ATTACHMENT0 + colors;
+                colors++;
+            }
+            if (size == nullptr)
+                size = &res;
+        }
+        // detach whatever a previous, larger pass left in this slot
+        for (unsigned int i = colors; i < m_FboColors[slot]; i++)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, 0, 0);
+        m_FboColors[slot] = colors;
+        if (!depth)
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+        if (colors > 0)
+            glDrawBuffers(colors, drawBuffers);
+        else
+            glDrawBuffer(GL_NONE);
+
+        if (size != nullptr)
+            glViewport(0, 0, size->desc.width, size->desc.height);
+    }
+
+public:
+    explicit FrameGraph(RenderTargetPool &pool) : m_Pool(pool) {
+    }
+
+    FrameGraph(const FrameGraph &) = delete;
+    FrameGraph &operator=(const FrameGraph &) = delete;
+
+    // starts describing a new frame, storage is kept between frames
+    void reset() {
+        m_Arena.reset();
+        for (auto &pass : m_Passes) {
+            pass.reads.clear();
+            pass.writes.clear();
+            m_SpareLists.push_back(std::move(pass.reads));
+            m_SpareLists.push_back(std::move(pass.writes));
+        }
+        m_Resources.clear();
+        m_Passes.clear();
+        m_Order.clear();
+        m_Culled = 0;
+    }
+
+    Resource create(const char *name, const TextureDesc &desc) {
+        m_Resources.push_back({name, desc, 0, false, false, 0, NONE, NONE});
+        return (Resource)m_Resources.size() - 1;
+    }
+
+    // a texture owned by someone else, e.g. the result of a pass with its own targets
+    Resource import(const char *name, unsigned int texture, const TextureDesc &desc) {
+        m_Resources.push_back({name, desc, texture, true, false, 0, NONE, NONE});
+        return (Resource)m_Resources.size() - 1;
+    }
+
+    // the default framebuffer; passes writing it are the roots that keep the graph alive
+    Resource backbuffer(int width, int height) {
+        m_Resources.push_back({"backbuffer", TextureDesc(width, height, GL_RGBA8), 0, true, true, 0, NONE, NONE});
+        return (Resource)m_Resources.size() - 1;
+    }
+
+    template <typename F>
+    unsigned int addPass(const char *name, F &&execute, bool manualTargets = false) {
+        PassNode pass;
+        pass.name = name;
+        pass.execute = Execute(m_Arena, std::forward<F>(execute));
+        for (auto *list : {&pass.reads, &pass.writes}) {
+            if (!m_SpareLists.empty()) {
+                *list = std::move(m_SpareLists.back());
+                m_SpareLists.pop_back();
+            }
+        }
+        pass.manualTargets = manualTargets;
+        pass.cpuMs = 0.0;
+        pass.timer = nullptr;
+        pass.alive = true;
+        m_Passes.push_back(std::move(pass));
+        return (unsigned int)m_Passes.size() - 1;
+    }
+
+    void read(unsigned int pass, Resource resource) {
+        m_Passes[pass].reads.push_back(resource);
+    }
+
+    void write(unsigned int pass, Resource resource) {
+        m_Passes[pass].writes.push_back(resource);
+    }
+
+    // culls unused passes, orders the rest and computes resource lifetimes
+    void compile() {
+        // cull: a pass survives if it writes the backbuffer or something a surviving pass reads
+        for (auto &pass : m_Passes)
+            for (Resource r : pass.reads)
+                m_Resources[r].readers++;
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto &pass : m_Passes) {
+                if (!pass.alive)
+                    continue;
+                bool needed = false;
+                for (Resource r : pass.writes)
+                    if (m_Resources[r].backbuffer || m_Resources[r].readers > 0)
+                        needed = true;
+                if (!needed) {
+                    pass.alive = false;
+                    m_Culled++;
+                    changed = true;
+                    for (Resource r : pass.reads)
+                        m_Resources[r].readers--;
+                }
+            }
+        }
+
+        // order: a pass runs after every pass that writes something it reads (Kahn, stable)
+        m_Scheduled.assign(m_Passes.size(), false);
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (unsigned int p = 0; p < m_Passes.size(); p++) {
+                if (m_Scheduled[p] || !m_Passes[p].alive)
+                    continue;
+                bool ready = true;
+                for (unsigned int q = 0; q < m_Passes.size() && ready; q++) {
+                    if (q == p || m_Scheduled[q] || !m_Passes[q].alive)
+                        continue;
+                    for (Resource r : m_Passes[p].reads)
+                        if (contains(m_Passes[q].writes, r) && !contains(m_Passes[p].writes, r))
+                            ready = false;
+                }
+                if (ready) {
+                    m_Scheduled[p] = true;
+                    m_Order.push_back(p);
+                    progress = true;
+                    break;
+                }
+            }
+        }
+        ASSERT(m_Order.size() + m_Culled == m_Passes.size(), "Frame graph has a dependency cycle!");
+
+        // lifetimes in execution order
+        for (unsigned int i = 0; i < m_Order.size(); i++) {
+            const PassNode &pass = m_Passes[m_Order[i]];
+            for (const std::vector<Resource> *list : {&pass.reads, &pass.writes}) {
+                for (Resource r : *list) {
+                    ResourceNode &res = m_Resources[r];
+                    if (res.first == NONE)
+                        res.first = i;
+                    res.last = i;
+                }
+            }
+        }
+    }
+
+    // gpu, when given, gets a timestamp zone per pass for the profiler trace
+    void execute(GpuProfiler *gpu = nullptr) {
+        for (unsigned int i = 0; i < m_Order.size(); i++) {
+            PassNode &pass = m_Passes[m_Order[i]];
+
+            // transient textures come from the pool right before their first use...
+            for (auto &res : m_Resources)
+                if (!res.imported && res.first == i) {
+                    res.texture = m_Pool.acquire(res.desc);
+                    // pooled textures change hands between resources, so the label follows the current one
+                    GLDebug::label(GL_TEXTURE, res.texture, res.name);
+                }
+
+            ProfileScope zone(pass.name);
+            GLDebugGroup group(pass.name);
+            if (gpu != nullptr)
+                gpu->begin(pass.name);
+            pass.timer = timer(pass.name);
+            pass.timer->begin();
+            auto start = std::chrono::steady_clock::now();
+            if (!pass.manualTargets)
+                bindTargets(i, pass);
+            pass.execute(*this);
+            pass.timer->end();
+            if (gpu != nullptr)
+                gpu->end();
+            pass.cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            // ...and go back right after their last, so later resources can alias them
+            for (auto &res : m_Resources)
+                if (!res.imported && res.last == i)
+                    m_Pool.release(res.texture);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        m_Pool.endFrame();
+    }
+
+    unsigned int texture(Resource resource) const {
+        return m_Resources[resource].texture;
+    }
+
+    const TextureDesc &desc(Resource resource) const {
+        return m_Resources[resource].desc;
+    }
+
+    unsigned int passCount() const {
+        return (unsigned int)m_Order.size();
+    }
+
+    unsigned int culledCount() const {
+        return m_Culled;
+    }
+
+    const char *passName(unsigned int i) const {
+        return m_Passes[m_Order[i]].name;
+    }
+
+    // CPU time spent recording the pass in the last execute()
+    double passCpuMs(unsigned int i) const {
+        return m_Passes[m_Order[i]].cpuMs;
+    }
+
+    // GPU time of the pass, a few frames old; every pass gets a timer, whatever it draws
+    double passGpuMs(unsigned int i) const {
+        const GpuTimer *timer = m_Passes[m_Order[i]].timer;
+        return timer != nullptr ? timer->lastMs() : 0.0;
+    }
+
+    // GPU time of all passes of the last execute()
+    double gpuMs() const {
+        double total = 0.0;
+        for (unsigned int i = 0; i < passCount(); i++)
+            total += passGpuMs(i);
+        return total;
+    }
+};
+
+#endif //PROJECT_BASE_FRAMEGRAPH_H
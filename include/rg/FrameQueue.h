@@ -0,0 +1,76 @@
+//
+// Fixed ring of frame packets handed from the thread that simulates a frame to
+// the thread that renders it. With N slots the producer can run up to N - 1
+// frames ahead; packets are written and read in place, never copied.
+//
+
+#ifndef PROJECT_BASE_FRAMEQUEUE_H
+#define PROJECT_BASE_FRAMEQUEUE_H
+
+#include <mutex>
+#include <condition_variable>
+
+template <typename T, unsigned int N = 2>
+class FrameQueue {
+    static_assert(N >= 2, "A frame queue needs at least two slots to overlap producer and consumer");
+
+    T m_Slots[N];
+    unsigned int m_Write = 0;
+    unsigned int m_Read = 0;
+    // published packets, including the one the consumer is working on
+    unsigned int m_Count = 0;
+    bool m_Closed = false;
+    std::mutex m_Mutex;
+    std::condition_variable m_Changed;
+
+public:
+    FrameQueue() = default;
+
+    FrameQueue(const FrameQueue &) = delete;
+    FrameQueue &operator=(const FrameQueue &) = delete;
+
+    // producer side: the next free packet, waits while every slot is in flight;
+    // nullptr once the queue was closed
+    T *beginWrite() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Changed.wait(lock, [this]() { return m_Count < N || m_Closed; });
+        return m_Closed ? nullptr : &m_Slots[m_Write];
+    }
+
+    void endWrite() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Write = (m_Write + 1) % N;
+            m_Count++;
+        }
+        m_Changed.notify_all();
+    }
+
+    // consumer side: the oldest published packet, stays valid until endRead();
+    // nullptr once the queue was closed and drained
+    T *beginRead() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Changed.wait(lock, [this]() { return m_Count > 0 || m_Closed; });
+        return m_Count > 0 ? &m_Slots[m_Read] : nullptr;
+    }
+
+    void endRead() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Read = (m_Read + 1) % N;
+            m_Count--;
+        }
+        m_Changed.notify_all();
+    }
+
+    // wakes both sides; the consumer still gets the packets published before this
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Closed = true;
+        }
+        m_Changed.notify_all();
+    }
+};
+
+#endif //PROJECT_BASE_FRAMEQUEUE_H
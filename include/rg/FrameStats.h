@@ -0,0 +1,111 @@
+//
+// Collects frame and per-pass times over a benchmark run and reduces them to
+// mean, percentiles and max. Samples are kept whole, percentiles are taken by
+// nearest rank over the sorted run.
+//
+
+#ifndef PROJECT_BASE_FRAMESTATS_H
+#define PROJECT_BASE_FRAMESTATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class FrameStats {
+public:
+    struct Summary {
+        unsigned int count = 0;
+        double mean = 0.0;
+        double p50 = 0.0;
+        double p95 = 0.0;
+        double p99 = 0.0;
+        double max = 0.0;
+    };
+
+private:
+    struct PassSamples {
+        std::string name;
+        std::vector<float> cpuMs;
+        std::vector<float> gpuMs;
+    };
+
+    std::vector<float> m_FrameMs;
+    std::vector<PassSamples> m_Passes;
+
+    static double percentile(const std::vector<float> &sorted, double p) {
+        size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    static void writeSummary(std::ostream &out, const Summary &s) {
+        out << "{\"mean\": " << s.mean << ", \"p50\": " << s.p50 << ", \"p95\": " << s.p95
+            << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << "}";
+    }
+
+public:
+    void reserve(unsigned int frames) {
+        m_FrameMs.reserve(frames);
+    }
+
+    void addFrame(float frameMs) {
+        m_FrameMs.push_back(frameMs);
+    }
+
+    // passes are matched by name, a pass culled in some frames just has fewer samples
+    void addPass(const char *name, double cpuMs, double gpuMs) {
+        auto it = std::find_if(m_Passes.begin(), m_Passes.end(),
+                               [&name](const PassSamples &pass) { return pass.name == name; });
+        if (it == m_Passes.end()) {
+            m_Passes.push_back(PassSamples{name, {}, {}});
+            m_Passes.back().cpuMs.reserve(m_FrameMs.capacity());
+            m_Passes.back().gpuMs.reserve(m_FrameMs.capacity());
+            it = m_Passes.end() - 1;
+        }
+        it->cpuMs.push_back((float)cpuMs);
+        it->gpuMs.push_back((float)gpuMs);
+    }
+
+    unsigned int frames() const {
+        return (unsigned int)m_FrameMs.size();
+    }
+
+    static Summary summarize(std::vector<float> samples) {
+        Summary s;
+        if (samples.empty())
+            return s;
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (float v : samples)
+            sum += v;
+        s.count = (unsigned int)samples.size();
+        s.mean = sum / samples.size();
+        s.p50 = percentile(samples, 50.0);
+        s.p95 = percentile(samples, 95.0);
+        s.p99 = percentile(samples, 99.0);
+        s.max = samples.back();
+        return s;
+    }
+
+    Summary frameSummary() const {
+        return summarize(m_FrameMs);
+    }
+
+    // {"frames": n, "frame_ms": {...}, "passes": {"name": {"cpu_ms": {...}, "gpu_ms": {...}}}}
+    void writeJson(std::ostream &out) const {
+        out << "{\"frames\": " << m_FrameMs.size() << ", \"frame_ms\": ";
+        writeSummary(out, frameSummary());
+        out << ", \"passes\": {";
+        for (size_t i = 0; i < m_Passes.size(); i++) {
+            out << (i > 0 ? ", " : "") << "\"" << m_Passes[i].name << "\": {\"cpu_ms\": ";
+            writeSummary(out, summarize(m_Passes[i].cpuMs));
+            out << ", \"gpu_ms\": ";
+            writeSummary(out, summarize(m_Passes[i].gpuMs));
+            out << "}";
+        }
+        out << "}}";
+    }
+};
+
+#endif //PROJECT_BASE_FRAMESTATS_H
@@ -0,0 +1,225 @@
+//
+// OpenGL error reporting through KHR_debug (core in 4.3): the driver calls back
+// with every message at or above the chosen severity, objects get readable
+// labels and each pass is wrapped in a debug group, so captures in RenderDoc
+// or apitrace show the frame graph. glad is generated for 3.3 only, so the
+// entry points are looked up by hand.
+//
+// Without KHR_debug the old glGetError path stays as a fallback, polled once
+// per frame. Building with SPACE_GL_CHECKS=0 compiles every check out.
+//
+
+#ifndef PROJECT_BASE_GLDEBUG_H
+#define PROJECT_BASE_GLDEBUG_H
+
+#include <cstring>
+#include <iostream>
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLMemory.h>
+
+#ifndef SPACE_GL_CHECKS
+#define SPACE_GL_CHECKS 1
+#endif
+
+#ifndef GL_DEBUG_OUTPUT
+#define GL_DEBUG_OUTPUT 0x92E0
+#define GL_DEBUG_OUTPUT_SYNCHRONOUS 0x8242
+#define GL_CONTEXT_FLAG_DEBUG_BIT 0x00000002
+#define GL_DEBUG_SOURCE_API 0x8246
+#define GL_DEBUG_SOURCE_WINDOW_SYSTEM 0x8247
+#define GL_DEBUG_SOURCE_SHADER_COMPILER 0x8248
+#define GL_DEBUG_SOURCE_THIRD_PARTY 0x8249
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_DEBUG_TYPE_ERROR 0x824C
+#define GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR 0x824D
+#define GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR 0x824E
+#define GL_DEBUG_TYPE_PORTABILITY 0x824F
+#define GL_DEBUG_TYPE_PERFORMANCE 0x8250
+#define GL_DEBUG_TYPE_PUSH_GROUP 0x8269
+#define GL_DEBUG_TYPE_POP_GROUP 0x826A
+#define GL_DEBUG_SEVERITY_HIGH 0x9146
+#define GL_DEBUG_SEVERITY_MEDIUM 0x9147
+#define GL_DEBUG_SEVERITY_LOW 0x9148
+#define GL_DEBUG_SEVERITY_NOTIFICATION 0x826B
+#define GL_BUFFER 0x82E0
+#define GL_SHADER 0x82E1
+#define GL_PROGRAM 0x82E2
+#define GL_QUERY 0x82E3
+#define GL_VERTEX_ARRAY 0x8074
+#endif
+
+class GLDebug {
+public:
+    enum Severity {
+        NOTIFICATION,
+        LOW,
+        MEDIUM,
+        HIGH
+    };
+
+private:
+    typedef void (APIENTRYP DebugMessageCallbackProc)(GLDEBUGPROC callback, const void *userParam);
+    typedef void (APIENTRYP DebugMessageControlProc)(GLenum source, GLenum type, GLenum severity, GLsizei count,
+                                                     const GLuint *ids, GLboolean enabled);
+    typedef void (APIENTRYP ObjectLabelProc)(GLenum identifier, GLuint name, GLsizei length, const GLchar *label);
+    typedef void (APIENTRYP PushDebugGroupProc)(GLenum source, GLuint id, GLsizei length, const GLchar *message);
+    typedef void (APIENTRYP PopDebugGroupProc)();
+
+    struct Procs {
+        DebugMessageCallbackProc messageCallback = nullptr;
+        DebugMessageControlProc messageControl = nullptr;
+        ObjectLabelProc objectLabel = nullptr;
+        PushDebugGroupProc pushGroup = nullptr;
+        PopDebugGroupProc popGroup = nullptr;
+    };
+
+    static Procs &procs() {
+        static Procs procs;
+        return procs;
+    }
+
+    static const char *severityName(GLenum severity) {
+        switch (severity) {
+            case GL_DEBUG_SEVERITY_HIGH: return "high";
+            case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+            case GL_DEBUG_SEVERITY_LOW: return "low";
+            default: return "notification";
+        }
+    }
+
+    static const char *typeName(GLenum type) {
+        switch (type) {
+            case GL_DEBUG_TYPE_ERROR: return "error";
+            case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+            case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+            case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+            case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+            default: return "other";
+        }
+    }
+
+    static const char *sourceName(GLenum source) {
+        switch (source) {
+            case GL_DEBUG_SOURCE_API: return "api";
+            case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+            case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+            case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+            case GL_DEBUG_SOURCE_APPLICATION: return "application";
+            default: return "other";
+        }
+    }
+
+    static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+                                  const GLchar *message, const void *userParam) {
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP)
+            return;
+        std::cerr << "[OpenGL " << severityName(severity) << " " << typeName(type) << "] " << sourceName(source)
+                  << " #" << id << ": " << message << '\n';
+    }
+
+    static bool hasExtension(const char *extension) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name != nullptr && std::strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    // call once a context is current; returns whether KHR_debug output is active
+    static bool init(GLADloadproc load, Severity minimum = MEDIUM, bool synchronous = false) {
+#if SPACE_GL_CHECKS
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        if ((major * 10 + minor < 43) && !hasExtension("GL_KHR_debug"))
+            return false;
+
+        Procs &p = procs();
+        p.messageCallback = (DebugMessageCallbackProc)load("glDebugMessageCallback");
+        p.messageControl = (DebugMessageControlProc)load("glDebugMessageControl");
+        p.objectLabel = (ObjectLabelProc)load("glObjectLabel");
+        p.pushGroup = (PushDebugGroupProc)load("glPushDebugGroup");
+        p.popGroup = (PopDebugGroupProc)load("glPopDebugGroup");
+        if (p.messageCallback == nullptr || p.messageControl == nullptr) {
+            p = Procs();
+            return false;
+        }
+
+        glEnable(GL_DEBUG_OUTPUT);
+        // synchronous output reports from inside the failing call, at the cost of driver parallelism
+        if (synchronous)
+            glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+        p.messageCallback(callback, nullptr);
+        const GLenum severities[] = {GL_DEBUG_SEVERITY_NOTIFICATION, GL_DEBUG_SEVERITY_LOW,
+                                     GL_DEBUG_SEVERITY_MEDIUM, GL_DEBUG_SEVERITY_HIGH};
+        for (int s = NOTIFICATION; s <= HIGH; s++)
+            p.messageControl(GL_DONT_CARE, GL_DONT_CARE, severities[s], 0, nullptr, s >= minimum ? GL_TRUE : GL_FALSE);
+        rg::debugOutputEnabled() = true;
+
+        GLint flags = 0;
+        glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+        if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT))
+            std::cout << "KHR_debug on a non-debug context, the driver may report little" << std::endl;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static bool active() {
+        return procs().messageCallback != nullptr;
+    }
+
+    static void label(GLenum identifier, GLuint name, const char *label) {
+        GLMemory::label(identifier, name, label);
+#if SPACE_GL_CHECKS
+        if (procs().objectLabel != nullptr && name != 0)
+            procs().objectLabel(identifier, name, -1, label);
+#endif
+    }
+
+    static void pushGroup(const char *name) {
+#if SPACE_GL_CHECKS
+        if (procs().pushGroup != nullptr)
+            procs().pushGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+#endif
+    }
+
+    static void popGroup() {
+#if SPACE_GL_CHECKS
+        if (procs().popGroup != nullptr)
+            procs().popGroup();
+#endif
+    }
+
+    // fallback for contexts without KHR_debug: one glGetError poll, e.g. per frame
+    static void checkErrors(const char *where) {
+#if SPACE_GL_CHECKS
+        if (active())
+            return;
+        while (GLenum error = glGetError())
+            std::cerr << "[OpenGL error] " << rg::openGLErrorToString(error) << " in " << where << '\n';
+#endif
+    }
+};
+
+class GLDebugGroup {
+public:
+    explicit GLDebugGroup(const char *name) {
+        GLDebug::pushGroup(name);
+    }
+
+    GLDebugGroup(const GLDebugGroup &) = delete;
+    GLDebugGroup &operator=(const GLDebugGroup &) = delete;
+
+    ~GLDebugGroup() {
+        GLDebug::popGroup();
+    }
+};
+
+#endif //PROJECT_BASE_GLDEBUG_H
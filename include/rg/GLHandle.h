@@ -0,0 +1,240 @@
+//
+// Move-only owners for GL object names. A handle cannot be copied, so two
+// owners never delete the same name; a moved-from handle owns nothing.
+//
+// Letting go of a name does not delete it on the spot. It waits in
+// GLDeletionQueue until the fence placed at the end of the frame it was
+// released in has signalled, so the GPU is done with everything that frame
+// submitted. Handles live on the render thread, like every other GL call.
+//
+// Sync objects are not handled here: glDeleteSync on a fence the GPU has not
+// reached yet is already deferred by GL itself, and every fence is owned by
+// the ring slot that waits on it.
+//
+
+#ifndef PROJECT_BASE_GLHANDLE_H
+#define PROJECT_BASE_GLHANDLE_H
+
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+
+enum class GLObjectType {
+    BUFFER,
+    TEXTURE,
+    VERTEX_ARRAY,
+    FRAMEBUFFER,
+    RENDERBUFFER,
+    QUERY,
+    PROGRAM,
+    // GL 4.0 / ARB_transform_feedback2, only there after loadExtensions
+    TRANSFORM_FEEDBACK
+};
+
+class GLDeletionQueue {
+    typedef std::pair<GLObjectType, GLuint> Name;
+
+    struct Batch {
+        GLsync fence;
+        std::vector<Name> names;
+    };
+
+    typedef void (APIENTRYP GenTransformFeedbacksProc)(GLsizei n, GLuint *ids);
+    typedef void (APIENTRYP DeleteTransformFeedbacksProc)(GLsizei n, const GLuint *ids);
+
+    struct State {
+        std::vector<Name> released;
+        std::deque<Batch> batches;
+        unsigned long deleted = 0;
+        GenTransformFeedbacksProc genTransformFeedbacks = nullptr;
+        DeleteTransformFeedbacksProc deleteTransformFeedbacks = nullptr;
+    };
+
+    static State &state() {
+        static State instance;
+        return instance;
+    }
+
+    static void destroy(const std::vector<Name> &names) {
+        for (const Name &name : names) {
+            switch (name.first) {
+                case GLObjectType::BUFFER: glDeleteBuffers(1, &name.second); break;
+                case GLObjectType::TEXTURE: glDeleteTextures(1, &name.second); break;
+                case GLObjectType::VERTEX_ARRAY: glDeleteVertexArrays(1, &name.second); break;
+                case GLObjectType::FRAMEBUFFER: glDeleteFramebuffers(1, &name.second); break;
+                case GLObjectType::RENDERBUFFER: glDeleteRenderbuffers(1, &name.second); break;
+                case GLObjectType::QUERY: glDeleteQueries(1, &name.second); break;
+                case GLObjectType::PROGRAM: glDeleteProgram(name.second); break;
+                case GLObjectType::TRANSFORM_FEEDBACK: state().deleteTransformFeedbacks(1, &name.second); break;
+            }
+        }
+        state().deleted += names.size();
+    }
+
+public:
+    // entry points of object types newer than the GL 3.3 loader; without them those types cannot be created
+    static void loadExtensions(GLADloadproc load) {
+        GLint major = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        bool found = major >= 4;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && !found; i++) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            found = name != nullptr && std::strcmp(name, "GL_ARB_transform_feedback2") == 0;
+        }
+        if (!found)
+            return;
+        State &s = state();
+        s.genTransformFeedbacks = (GenTransformFeedbacksProc)load("glGenTransformFeedbacks");
+        s.deleteTransformFeedbacks = (DeleteTransformFeedbacksProc)load("glDeleteTransformFeedbacks");
+        if (s.genTransformFeedbacks == nullptr || s.deleteTransformFeedbacks == nullptr) {
+            s.genTransformFeedbacks = nullptr;
+            s.deleteTransformFeedbacks = nullptr;
+        }
+    }
+
+    static bool supported(GLObjectType type) {
+        return type != GLObjectType::TRANSFORM_FEEDBACK || state().genTransformFeedbacks != nullptr;
+    }
+
+    static GLuint create(GLObjectType type) {
+        GLuint name = 0;
+        switch (type) {
+            case GLObjectType::BUFFER: glGenBuffers(1, &name); break;
+            case GLObjectType::TEXTURE: glGenTextures(1, &name); break;
+            case GLObjectType::VERTEX_ARRAY: glGenVertexArrays(1, &name); break;
+            case GLObjectType::FRAMEBUFFER: glGenFramebuffers(1, &name); break;
+            case GLObjectType::RENDERBUFFER: glGenRenderbuffers(1, &name); break;
+            case GLObjectType::QUERY: glGenQueries(1, &name); break;
+            case GLObjectType::PROGRAM: name = glCreateProgram(); break;
+            case GLObjectType::TRANSFORM_FEEDBACK:
+                if (state().genTransformFeedbacks != nullptr)
+                    state().genTransformFeedbacks(1, &name);
+                break;
+        }
+        return name;
+    }
+
+    static void release(GLObjectType type, GLuint name) {
+        if (name != 0)
+            state().released.push_back(Name(type, name));
+    }
+
+    // closes the frame: what was released so far goes once the GPU has finished it
+    static void endFrame() {
+        State &s = state();
+        if (s.released.empty())
+            return;
+        s.batches.push_back(Batch{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(s.released)});
+        s.released.clear();
+    }
+
+    // deletes the batches of finished frames, oldest first; never waits
+    static void collect() {
+        State &s = state();
+        while (!s.batches.empty()) {
+            Batch &batch = s.batches.front();
+            if (glClientWaitSync(batch.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                return;
+            glDeleteSync(batch.fence);
+            destroy(batch.names);
+            s.batches.pop_front();
+        }
+    }
+
+    // waits for the GPU and deletes everything; for shutdown, while the context is still current
+    static void flush() {
+        State &s = state();
+        glFinish();
+        for (Batch &batch : s.batches) {
+            glDeleteSync(batch.fence);
+            destroy(batch.names);
+        }
+        s.batches.clear();
+        destroy(s.released);
+        s.released.clear();
+    }
+
+    // names waiting for their frame to finish
+    static size_t pending() {
+        const State &s = state();
+        size_t count = s.released.size();
+        for (const Batch &batch : s.batches)
+            count += batch.names.size();
+        return count;
+    }
+
+    static unsigned long deleted() {
+        return state().deleted;
+    }
+};
+
+template <GLObjectType Type>
+class GLHandle {
+    GLuint m_Name = 0;
+
+public:
+    GLHandle() = default;
+
+    // takes over a name created elsewhere
+    explicit GLHandle(GLuint name) : m_Name(name) {}
+
+    GLHandle(GLHandle &&other) noexcept : m_Name(other.m_Name) {
+        other.m_Name = 0;
+    }
+
+    GLHandle &operator=(GLHandle &&other) noexcept {
+        if (this != &other) {
+            reset(other.m_Name);
+            other.m_Name = 0;
+        }
+        return *this;
+    }
+
+    GLHandle(const GLHandle &) = delete;
+    GLHandle &operator=(const GLHandle &) = delete;
+
+    ~GLHandle() {
+        reset();
+    }
+
+    static GLHandle create() {
+        return GLHandle(GLDeletionQueue::create(Type));
+    }
+
+    GLuint get() const {
+        return m_Name;
+    }
+
+    explicit operator bool() const {
+        return m_Name != 0;
+    }
+
+    // gives the name up without deleting it
+    GLuint release() {
+        GLuint name = m_Name;
+        m_Name = 0;
+        return name;
+    }
+
+    void reset(GLuint name = 0) {
+        if (m_Name != 0 && m_Name != name)
+            GLDeletionQueue::release(Type, m_Name);
+        m_Name = name;
+    }
+};
+
+typedef GLHandle<GLObjectType::BUFFER> GLBuffer;
+typedef GLHandle<GLObjectType::TEXTURE> GLTexture;
+typedef GLHandle<GLObjectType::VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GLObjectType::FRAMEBUFFER> GLFramebuffer;
+typedef GLHandle<GLObjectType::RENDERBUFFER> GLRenderbuffer;
+typedef GLHandle<GLObjectType::QUERY> GLQuery;
+typedef GLHandle<GLObjectType::PROGRAM> GLProgram;
+typedef GLHandle<GLObjectType::TRANSFORM_FEEDBACK> GLTransformFeedback;
+
+#endif //PROJECT_BASE_GLHANDLE_H
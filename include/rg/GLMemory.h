@@ -0,0 +1,498 @@
+//
+// Registry of the live GL objects: buffers, textures, renderbuffers,
+// framebuffers, vertex arrays and programs, each with its size in bytes, an
+// owner and the place it was created. Like GLStats it swaps glad's function
+// pointers, so nothing is tracked until install() is called. Only the thread
+// owning the context may use it.
+//
+// Owners come from GL_MEMORY_OWNER scopes around the code that creates
+// objects; debug labels name single objects. Sizes are what the formats need,
+// drivers may pad them. Whatever is still alive at shutdown is a leak.
+//
+
+#ifndef PROJECT_BASE_GLMEMORY_H
+#define PROJECT_BASE_GLMEMORY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+class GLMemory {
+public:
+    enum Category {
+        BUFFER,
+        TEXTURE,
+        RENDERBUFFER,
+        FRAMEBUFFER,
+        VERTEX_ARRAY,
+        PROGRAM,
+        CATEGORY_COUNT
+    };
+
+    struct Totals {
+        unsigned long objects[CATEGORY_COUNT] = {};
+        size_t bytes[CATEGORY_COUNT] = {};
+    };
+
+private:
+    struct Image {
+        GLenum target;
+        GLint level;
+        GLsizei width, height, depth;
+        size_t bytes;
+    };
+
+    struct Object {
+        Category category;
+        size_t bytes = 0;
+        const char *owner = "untagged";
+        const char *file = "";
+        int line = 0;
+        std::string label;
+        std::vector<Image> images;
+    };
+
+    struct Owner {
+        const char *name;
+        const char *file;
+        int line;
+    };
+
+    struct Real {
+        PFNGLGENBUFFERSPROC genBuffers = nullptr;
+        PFNGLDELETEBUFFERSPROC deleteBuffers = nullptr;
+        PFNGLBUFFERDATAPROC bufferData = nullptr;
+        PFNGLGENTEXTURESPROC genTextures = nullptr;
+        PFNGLDELETETEXTURESPROC deleteTextures = nullptr;
+        PFNGLTEXIMAGE2DPROC texImage2D = nullptr;
+        PFNGLTEXIMAGE3DPROC texImage3D = nullptr;
+        PFNGLGENERATEMIPMAPPROC generateMipmap = nullptr;
+        PFNGLGENRENDERBUFFERSPROC genRenderbuffers = nullptr;
+        PFNGLDELETERENDERBUFFERSPROC deleteRenderbuffers = nullptr;
+        PFNGLRENDERBUFFERSTORAGEPROC renderbufferStorage = nullptr;
+        PFNGLRENDERBUFFERSTORAGEMULTISAMPLEPROC renderbufferStorageMultisample = nullptr;
+        PFNGLGENFRAMEBUFFERSPROC genFramebuffers = nullptr;
+        PFNGLDELETEFRAMEBUFFERSPROC deleteFramebuffers = nullptr;
+        PFNGLGENVERTEXARRAYSPROC genVertexArrays = nullptr;
+        PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays = nullptr;
+        PFNGLCREATEPROGRAMPROC createProgram = nullptr;
+        PFNGLDELETEPROGRAMPROC deleteProgram = nullptr;
+    };
+
+    struct State {
+        bool installed = false;
+        Real real;
+        std::unordered_map<uint64_t, Object> objects;
+        std::vector<Owner> owners;
+    };
+
+    static State &state() {
+        static State state;
+        return state;
+    }
+
+    static uint64_t key(Category category, GLuint name) {
+        return ((uint64_t)category << 32) | name;
+    }
+
+    static Object *find(Category category, GLuint name) {
+        auto it = state().objects.find(key(category, name));
+        return it == state().objects.end() ? nullptr : &it->second;
+    }
+
+    static void add(Category category, GLuint name) {
+        if (name == 0)
+            return;
+        Object object;
+        object.category = category;
+        if (!state().owners.empty()) {
+            const Owner &owner = state().owners.back();
+            object.owner = owner.name;
+            object.file = owner.file;
+            object.line = owner.line;
+        }
+        state().objects[key(category, name)] = object;
+    }
+
+    static void remove(Category category, GLsizei n, const GLuint *names) {
+        for (GLsizei i = 0; i < n; i++)
+            state().objects.erase(key(category, names[i]));
+    }
+
+    static GLuint bound(GLenum binding) {
+        GLint name = 0;
+        glad_glGetIntegerv(binding, &name);
+        return (GLuint)name;
+    }
+
+    static GLenum bufferBinding(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER: return GL_ARRAY_BUFFER_BINDING;
+            case GL_ELEMENT_ARRAY_BUFFER: return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+            case GL_UNIFORM_BUFFER: return GL_UNIFORM_BUFFER_BINDING;
+            case GL_PIXEL_PACK_BUFFER: return GL_PIXEL_PACK_BUFFER_BINDING;
+            case GL_PIXEL_UNPACK_BUFFER: return GL_PIXEL_UNPACK_BUFFER_BINDING;
+            case GL_TRANSFORM_FEEDBACK_BUFFER: return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+            // these targets double as their binding queries
+            default: return target;
+        }
+    }
+
+    static GLenum textureBinding(GLenum target) {
+        if (target >= GL_TEXTURE_CUBE_MAP_POSITIVE_X && target <= GL_TEXTURE_CUBE_MAP_NEGATIVE_Z)
+            return GL_TEXTURE_BINDING_CUBE_MAP;
+        switch (target) {
+            case GL_TEXTURE_CUBE_MAP: return GL_TEXTURE_BINDING_CUBE_MAP;
+            case GL_TEXTURE_2D_ARRAY: return GL_TEXTURE_BINDING_2D_ARRAY;
+            case GL_TEXTURE_3D: return GL_TEXTURE_BINDING_3D;
+            case GL_TEXTURE_RECTANGLE: return GL_TEXTURE_BINDING_RECTANGLE;
+            case GL_TEXTURE_1D: return GL_TEXTURE_BINDING_1D;
+            case GL_TEXTURE_1D_ARRAY: return GL_TEXTURE_BINDING_1D_ARRAY;
+            default: return GL_TEXTURE_BINDING_2D;
+        }
+    }
+
+    static size_t texelBytes(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_RED: case GL_R8: return 1;
+            case GL_RG: case GL_RG8: case GL_R16F: return 2;
+            case GL_RGB: case GL_RGB8: case GL_SRGB: case GL_SRGB8: return 3;
+            case GL_RGB16F: return 6;
+            case GL_RGBA16F: case GL_RG32F: return 8;
+            case GL_RGB32F: return 12;
+            case GL_RGBA32F: return 16;
+            // RGBA8, SRGB8_ALPHA8, RG16F, R32F, R11F_G11F_B10F, the depth formats
+            default: return 4;
+        }
+    }
+
+    static void sum(Object &object) {
+        object.bytes = 0;
+        for (const Image &image : object.images)
+            object.bytes += image.bytes;
+    }
+
+    static void setImage(GLenum target, GLint level, GLenum internalFormat, GLsizei width, GLsizei height,
+                         GLsizei depth) {
+        if (target == GL_PROXY_TEXTURE_2D || target == GL_PROXY_TEXTURE_CUBE_MAP || target == GL_PROXY_TEXTURE_3D ||
+            target == GL_PROXY_TEXTURE_2D_ARRAY)
+            return;
+        Object *object = find(TEXTURE, bound(textureBinding(target)));
+        if (object == nullptr)
+            return;
+        Image image = {target, level, width, height, depth, (size_t)width * height * depth * texelBytes(internalFormat)};
+        auto it = std::find_if(object->images.begin(), object->images.end(), [&](const Image &i) {
+            return i.target == target && i.level == level;
+        });
+        if (it != object->images.end())
+            *it = image;
+        else
+            object->images.push_back(image);
+        sum(*object);
+    }
+
+    static void APIENTRY genBuffers(GLsizei n, GLuint *names) {
+        state().real.genBuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            add(BUFFER, names[i]);
+    }
+
+    static void APIENTRY deleteBuffers(GLsizei n, const GLuint *names) {
+        remove(BUFFER, n, names);
+        state().real.deleteBuffers(n, names);
+    }
+
+    static void APIENTRY bufferData(GLenum target, GLsizeiptr size, const void *data, GLenum usage) {
+        state().real.bufferData(target, size, data, usage);
+        setBufferSize(bound(bufferBinding(target)), (size_t)size);
+    }
+
+    static void APIENTRY genTextures(GLsizei n, GLuint *names) {
+        state().real.genTextures(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            add(TEXTURE, names[i]);
+    }
+
+    static void APIENTRY deleteTextures(GLsizei n, const GLuint *names) {
+        remove(TEXTURE, n, names);
+        state().real.deleteTextures(n, names);
+    }
+
+    static void APIENTRY texImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                    GLint border, GLenum format, GLenum type, const void *pixels) {
+        state().real.texImage2D(target, level, internalFormat, width, height, border, format, type, pixels);
+        setImage(target, level, (GLenum)internalFormat, width, height, 1);
+    }
+
+    static void APIENTRY texImage3D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                    GLsizei depth, GLint border, GLenum format, GLenum type, const void *pixels) {
+        state().real.texImage3D(target, level, internalFormat, width, height, depth, border, format, type, pixels);
+        setImage(target, level, (GLenum)internalFormat, width, height, depth);
+    }
+
+    // the chain below every base image, array layers and cube faces keep their count
+    static void APIENTRY generateMipmap(GLenum target) {
+        state().real.generateMipmap(target);
+        Object *object = find(TEXTURE, bound(textureBinding(target)));
+        if (object == nullptr)
+            return;
+        std::vector<Image> images;
+        for (const Image &base : object->images) {
+            if (base.level != 0)
+                continue;
+            size_t texel = base.bytes / std::max<size_t>(1, (size_t)base.width * base.height * base.depth);
+            bool layered = target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_1D_ARRAY;
+            Image image = base;
+            images.push_back(image);
+            while (image.width > 1 || image.height > 1 || (!layered && image.depth > 1)) {
+                image.level++;
+                image.width = std::max(1, image.width / 2);
+                image.height = std::max(1, image.height / 2);
+                if (!layered)
+                    image.depth = std::max(1, image.depth / 2);
+                image.bytes = (size_t)image.width * image.height * image.depth * texel;
+                images.push_back(image);
+            }
+        }
+        object->images = images;
+        sum(*object);
+    }
+
+    static void APIENTRY genRenderbuffers(GLsizei n, GLuint *names) {
+        state().real.genRenderbuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            add(RENDERBUFFER, names[i]);
+    }
+
+    static void APIENTRY deleteRenderbuffers(GLsizei n, const GLuint *names) {
+        remove(RENDERBUFFER, n, names);
+        state().real.deleteRenderbuffers(n, names);
+    }
+
+    static void APIENTRY renderbufferStorageMultisample(GLenum target, GLsizei samples, GLenum internalFormat,
+                                                        GLsizei width, GLsizei height) {
+        state().real.renderbufferStorageMultisample(target, samples, internalFormat, width, height);
+        if (Object *object = find(RENDERBUFFER, bound(GL_RENDERBUFFER_BINDING)))
+            object->bytes = (size_t)width * height * texelBytes(internalFormat) * std::max(1, samples);
+    }
+
+    static void APIENTRY renderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height) {
+        state().real.renderbufferStorage(target, internalFormat, width, height);
+        if (Object *object = find(RENDERBUFFER, bound(GL_RENDERBUFFER_BINDING)))
+            object->bytes = (size_t)width * height * texelBytes(internalFormat);
+    }
+
+    static void APIENTRY genFramebuffers(GLsizei n, GLuint *names) {
+        state().real.genFramebuffers(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            add(FRAMEBUFFER, names[i]);
+    }
+
+    static void APIENTRY deleteFramebuffers(GLsizei n, const GLuint *names) {
+        remove(FRAMEBUFFER, n, names);
+        state().real.deleteFramebuffers(n, names);
+    }
+
+    static void APIENTRY genVertexArrays(GLsizei n, GLuint *names) {
+        state().real.genVertexArrays(n, names);
+        for (GLsizei i = 0; i < n; i++)
+            add(VERTEX_ARRAY, names[i]);
+    }
+
+    static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint *names) {
+        remove(VERTEX_ARRAY, n, names);
+        state().real.deleteVertexArrays(n, names);
+    }
+
+    static GLuint APIENTRY createProgram() {
+        GLuint program = state().real.createProgram();
+        add(PROGRAM, program);
+        return program;
+    }
+
+    static void APIENTRY deleteProgram(GLuint program) {
+        remove(PROGRAM, 1, &program);
+        state().real.deleteProgram(program);
+    }
+
+    template <typename Proc>
+    static void swap(Proc &entry, Proc &real, Proc hook) {
+        real = entry;
+        entry = hook;
+    }
+
+    static void printBytes(std::ostream &out, size_t bytes) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.2f MB", bytes / (1024.0 * 1024.0));
+        out << text;
+    }
+
+public:
+    // call right after glad is loaded; objects created before it are not known
+    static void install() {
+        State &s = state();
+        if (s.installed)
+            return;
+        Real &r = s.real;
+        swap(glad_glGenBuffers, r.genBuffers, genBuffers);
+        swap(glad_glDeleteBuffers, r.deleteBuffers, deleteBuffers);
+        swap(glad_glBufferData, r.bufferData, bufferData);
+        swap(glad_glGenTextures, r.genTextures, genTextures);
+        swap(glad_glDeleteTextures, r.deleteTextures, deleteTextures);
+        swap(glad_glTexImage2D, r.texImage2D, texImage2D);
+        swap(glad_glTexImage3D, r.texImage3D, texImage3D);
+        swap(glad_glGenerateMipmap, r.generateMipmap, generateMipmap);
+        swap(glad_glGenRenderbuffers, r.genRenderbuffers, genRenderbuffers);
+        swap(glad_glDeleteRenderbuffers, r.deleteRenderbuffers, deleteRenderbuffers);
+        swap(glad_glRenderbufferStorage, r.renderbufferStorage, renderbufferStorage);
+        swap(glad_glRenderbufferStorageMultisample, r.renderbufferStorageMultisample, renderbufferStorageMultisample);
+        swap(glad_glGenFramebuffers, r.genFramebuffers, genFramebuffers);
+        swap(glad_glDeleteFramebuffers, r.deleteFramebuffers, deleteFramebuffers);
+        swap(glad_glGenVertexArrays, r.genVertexArrays, genVertexArrays);
+        swap(glad_glDeleteVertexArrays, r.deleteVertexArrays, deleteVertexArrays);
+        swap(glad_glCreateProgram, r.createProgram, createProgram);
+        swap(glad_glDeleteProgram, r.deleteProgram, deleteProgram);
+        s.installed = true;
+    }
+
+    static bool installed() {
+        return state().installed;
+    }
+
+    static const char *categoryName(Category category) {
+        switch (category) {
+            case BUFFER: return "buffers";
+            case TEXTURE: return "textures";
+            case RENDERBUFFER: return "renderbuffers";
+            case FRAMEBUFFER: return "framebuffers";
+            case VERTEX_ARRAY: return "vertex arrays";
+            default: return "programs";
+        }
+    }
+
+    // for storage allocated outside glBufferData, e.g. glBufferStorage
+    static void setBufferSize(GLuint buffer, size_t bytes) {
+        if (Object *object = find(BUFFER, buffer))
+            object->bytes = bytes;
+    }
+
+    // called by GLDebug::label, so labelled objects show up by name
+    static void label(GLenum identifier, GLuint name, const char *label) {
+        if (!installed())
+            return;
+        Object *object = nullptr;
+        switch (identifier) {
+            case GL_TEXTURE: object = find(TEXTURE, name); break;
+            case GL_FRAMEBUFFER: object = find(FRAMEBUFFER, name); break;
+            case GL_RENDERBUFFER: object = find(RENDERBUFFER, name); break;
+            case 0x82E0: object = find(BUFFER, name); break;        // GL_BUFFER
+            case 0x82E2: object = find(PROGRAM, name); break;       // GL_PROGRAM
+            case 0x8074: object = find(VERTEX_ARRAY, name); break;  // GL_VERTEX_ARRAY
+            default: break;
+        }
+        if (object != nullptr)
+            object->label = label;
+    }
+
+    static void pushOwner(const char *name, const char *file, int line) {
+        state().owners.push_back(Owner{name, file, line});
+    }
+
+    static void popOwner() {
+        state().owners.pop_back();
+    }
+
+    static Totals totals() {
+        Totals t;
+        for (const auto &entry : state().objects) {
+            t.objects[entry.second.category]++;
+            t.bytes[entry.second.category] += entry.second.bytes;
+        }
+        return t;
+    }
+
+    static size_t totalBytes() {
+        Totals t = totals();
+        size_t bytes = 0;
+        for (size_t b : t.bytes)
+            bytes += b;
+        return bytes;
+    }
+
+    // per category totals, then objects grouped by owner and creation site, largest first
+    static void report(std::ostream &out, bool atShutdown) {
+        Totals t = totals();
+        unsigned long objects = 0;
+        for (unsigned long o : t.objects)
+            objects += o;
+        out << (atShutdown ? "GL objects leaked: " : "GL objects: ") << objects << ", ";
+        printBytes(out, totalBytes());
+        out << '\n';
+        for (int c = 0; c < CATEGORY_COUNT; c++) {
+            if (t.objects[c] == 0)
+                continue;
+            out << "  " << categoryName((Category)c) << ": " << t.objects[c] << ", ";
+            printBytes(out, t.bytes[c]);
+            out << '\n';
+        }
+
+        struct Group {
+            unsigned long count = 0;
+            size_t bytes = 0;
+            std::string example;
+        };
+        std::map<std::tuple<int, std::string, std::string, int>, Group> groups;
+        for (const auto &entry : state().objects) {
+            const Object &o = entry.second;
+            Group &g = groups[std::make_tuple((int)o.category, std::string(o.owner), std::string(o.file), o.line)];
+            g.count++;
+            g.bytes += o.bytes;
+            if (g.example.empty())
+                g.example = o.label;
+        }
+        std::vector<std::pair<std::tuple<int, std::string, std::string, int>, Group>> sorted(groups.begin(), groups.end());
+        std::sort(sorted.begin(), sorted.end(), [](const decltype(sorted)::value_type &a, const decltype(sorted)::value_type &b) {
+            return a.second.bytes > b.second.bytes;
+        });
+        for (const auto &entry : sorted) {
+            const Group &g = entry.second;
+            out << "  " << g.count << " " << categoryName((Category)std::get<0>(entry.first)) << ", ";
+            printBytes(out, g.bytes);
+            out << ", " << std::get<1>(entry.first);
+            if (std::get<3>(entry.first) > 0)
+                out << " (" << std::get<2>(entry.first) << ":" << std::get<3>(entry.first) << ")";
+            if (!g.example.empty())
+                out << " e.g. \"" << g.example << "\"";
+            out << '\n';
+        }
+    }
+};
+
+// objects created while this scope is alive belong to owner
+class GLMemoryOwner {
+public:
+    GLMemoryOwner(const char *owner, const char *file, int line) {
+        GLMemory::pushOwner(owner, file, line);
+    }
+
+    GLMemoryOwner(const GLMemoryOwner &) = delete;
+    GLMemoryOwner &operator=(const GLMemoryOwner &) = delete;
+
+    ~GLMemoryOwner() {
+        GLMemory::popOwner();
+    }
+};
+
+#define GL_MEMORY_CONCAT_(a, b) a##b
+#define GL_MEMORY_CONCAT(a, b) GL_MEMORY_CONCAT_(a, b)
+// owner must outlive the registry, string literals are the usual choice
+#define GL_MEMORY_OWNER(owner) GLMemoryOwner GL_MEMORY_CONCAT(glMemoryOwner, __LINE__)(owner, __FILE__, __LINE__)
+
+#endif //PROJECT_BASE_GLMEMORY_H
@@ -0,0 +1,176 @@
+//
+// Counts draw calls, triangles, uniform uploads and state changes by swapping
+// glad's function pointers for counting wrappers. Nothing is wrapped until
+// install() is called, so the counters cost nothing while nobody looks at them.
+// Counters are not synchronised, only the thread owning the context may draw.
+//
+
+#ifndef PROJECT_BASE_GLSTATS_H
+#define PROJECT_BASE_GLSTATS_H
+
+#include <functional>
+#include <vector>
+#include <glad/glad.h>
+
+class GLStats {
+public:
+    struct Counters {
+        unsigned long drawCalls = 0;
+        unsigned long triangles = 0;
+        unsigned long uniformUploads = 0;
+        unsigned long stateChanges = 0;
+    };
+
+    static Counters &counters() {
+        static Counters counters;
+        return counters;
+    }
+
+    static void reset() {
+        counters() = Counters();
+    }
+
+    static bool installed() {
+        return !restorers().empty();
+    }
+
+    static void install() {
+        if (installed())
+            return;
+        Counters &c = counters();
+        hookDraws();
+
+        wrap<0>(glad_glUniform1i, c.uniformUploads);
+        wrap<1>(glad_glUniform1f, c.uniformUploads);
+        wrap<2>(glad_glUniform2f, c.uniformUploads);
+        wrap<3>(glad_glUniform2fv, c.uniformUploads);
+        wrap<4>(glad_glUniform3f, c.uniformUploads);
+        wrap<5>(glad_glUniform3fv, c.uniformUploads);
+        wrap<6>(glad_glUniform4f, c.uniformUploads);
+        wrap<7>(glad_glUniform4fv, c.uniformUploads);
+        wrap<8>(glad_glUniformMatrix2fv, c.uniformUploads);
+        wrap<9>(glad_glUniformMatrix3fv, c.uniformUploads);
+        wrap<10>(glad_glUniformMatrix4fv, c.uniformUploads);
+
+        wrap<11>(glad_glUseProgram, c.stateChanges);
+        wrap<12>(glad_glBindVertexArray, c.stateChanges);
+        wrap<13>(glad_glBindTexture, c.stateChanges);
+        wrap<14>(glad_glBindFramebuffer, c.stateChanges);
+        wrap<15>(glad_glBindBufferRange, c.stateChanges);
+    }
+
+    static void uninstall() {
+        for (auto &restore : restorers())
+            restore();
+        restorers().clear();
+    }
+
+private:
+    static std::vector<std::function<void()>> &restorers() {
+        static std::vector<std::function<void()>> restorers;
+        return restorers;
+    }
+
+    // one instantiation per wrapped entry point, Id keeps same-signature functions apart
+    template <int Id, typename R, typename... Args>
+    struct Wrapper {
+        static R (APIENTRYP real)(Args...);
+        static unsigned long *counter;
+
+        static R APIENTRY call(Args... args) {
+            (*counter)++;
+            return real(args...);
+        }
+    };
+
+    template <int Id, typename R, typename... Args>
+    static void wrap(R (APIENTRYP &entry)(Args...), unsigned long &counter) {
+        typedef Wrapper<Id, R, Args...> W;
+        W::real = entry;
+        W::counter = &counter;
+        entry = &W::call;
+        R (APIENTRYP *slot)(Args...) = &entry;
+        restorers().push_back([slot]() { *slot = W::real; });
+    }
+
+    static unsigned long primitives(GLenum mode, GLsizei count) {
+        switch (mode) {
+            case GL_TRIANGLES:
+                return count / 3;
+            case GL_TRIANGLE_STRIP:
+            case GL_TRIANGLE_FAN:
+                return count > 2 ? count - 2 : 0;
+            default:
+                return 0;
+        }
+    }
+
+    static PFNGLDRAWARRAYSPROC &realDrawArrays() {
+        static PFNGLDRAWARRAYSPROC proc = nullptr;
+        return proc;
+    }
+
+    static PFNGLDRAWELEMENTSPROC &realDrawElements() {
+        static PFNGLDRAWELEMENTSPROC proc = nullptr;
+        return proc;
+    }
+
+    static PFNGLDRAWARRAYSINSTANCEDPROC &realDrawArraysInstanced() {
+        static PFNGLDRAWARRAYSINSTANCEDPROC proc = nullptr;
+        return proc;
+    }
+
+    static PFNGLDRAWELEMENTSINSTANCEDPROC &realDrawElementsInstanced() {
+        static PFNGLDRAWELEMENTSINSTANCEDPROC proc = nullptr;
+        return proc;
+    }
+
+    static void APIENTRY drawArrays(GLenum mode, GLint first, GLsizei count) {
+        counters().drawCalls++;
+        counters().triangles += primitives(mode, count);
+        realDrawArrays()(mode, first, count);
+    }
+
+    static void APIENTRY drawElements(GLenum mode, GLsizei count, GLenum type, const void *indices) {
+        counters().drawCalls++;
+        counters().triangles += primitives(mode, count);
+        realDrawElements()(mode, count, type, indices);
+    }
+
+    static void APIENTRY drawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instances) {
+        counters().drawCalls++;
+        counters().triangles += primitives(mode, count) * instances;
+        realDrawArraysInstanced()(mode, first, count, instances);
+    }
+
+    static void APIENTRY drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void *indices, GLsizei instances) {
+        counters().drawCalls++;
+        counters().triangles += primitives(mode, count) * instances;
+        realDrawElementsInstanced()(mode, count, type, indices, instances);
+    }
+
+    static void hookDraws() {
+        realDrawArrays() = glad_glDrawArrays;
+        realDrawElements() = glad_glDrawElements;
+        realDrawArraysInstanced() = glad_glDrawArraysInstanced;
+        realDrawElementsInstanced() = glad_glDrawElementsInstanced;
+        glad_glDrawArrays = drawArrays;
+        glad_glDrawElements = drawElements;
+        glad_glDrawArraysInstanced = drawArraysInstanced;
+        glad_glDrawElementsInstanced = drawElementsInstanced;
+        restorers().push_back([]() {
+            glad_glDrawArrays = realDrawArrays();
+            glad_glDrawElements = realDrawElements();
+            glad_glDrawArraysInstanced = realDrawArraysInstanced();
+            glad_glDrawElementsInstanced = realDrawElementsInstanced();
+        });
+    }
+};
+
+template <int Id, typename R, typename... Args>
+R (APIENTRYP GLStats::Wrapper<Id, R, Args...>::real)(Args...) = nullptr;
+
+template <int Id, typename R, typename... Args>
+unsigned long *GLStats::Wrapper<Id, R, Args...>::counter = nullptr;
+
+#endif //PROJECT_BASE_GLSTATS_H
@@ -0,0 +1,104 @@
+//
+// GPU zones for the profiler trace. Each zone is a pair of GL_TIMESTAMP queries
+// read back a few frames later without waiting, converted to the CPU clock and
+// recorded on a "gpu" track, so GPU work lines up with the CPU zones that
+// issued it.
+//
+
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <vector>
+#include <glad/glad.h>
+#include <rg/GLHandle.h>
+#include <rg/Profiler.h>
+
+class GpuProfiler {
+    struct Zone {
+        const char *name;
+        GLQuery queries[2];
+        bool pending;
+    };
+
+    static const unsigned int ZONES = 128;
+    // the GPU and CPU clocks drift apart, the offset is re-measured this often
+    static const unsigned int CALIBRATE_EVERY = 300;
+
+    Zone m_Zones[ZONES];
+    unsigned int m_Next = 0;
+    std::vector<unsigned int> m_Open;
+    int64_t m_Offset = 0;
+    unsigned int m_Frames = 0;
+    Profiler::Track &m_Track;
+
+    void read(Zone &zone) {
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(zone.queries[0].get(), GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(zone.queries[1].get(), GL_QUERY_RESULT, &end);
+        zone.pending = false;
+        m_Track.record(zone.name, (uint64_t)((int64_t)start + m_Offset), (uint64_t)((int64_t)end + m_Offset));
+    }
+
+public:
+    GpuProfiler() : m_Track(Profiler::addTrack("gpu")) {
+        for (auto &zone : m_Zones) {
+            for (auto &query : zone.queries)
+                query = GLQuery::create();
+            zone.pending = false;
+        }
+        calibrate();
+    }
+
+    GpuProfiler(const GpuProfiler &) = delete;
+    GpuProfiler &operator=(const GpuProfiler &) = delete;
+
+    void calibrate() {
+        GLint64 gpu = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpu);
+        m_Offset = (int64_t)Profiler::now() - gpu;
+    }
+
+    // records finished zones; call once per frame
+    void collect() {
+        if (++m_Frames % CALIBRATE_EVERY == 0 && Profiler::enabled())
+            calibrate();
+        for (auto &zone : m_Zones) {
+            if (!zone.pending)
+                continue;
+            GLint available = 0;
+            glGetQueryObjectiv(zone.queries[1].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+                read(zone);
+        }
+    }
+
+    // zones may nest; begin/end pairs must match even if profiling is toggled in between
+    void begin(const char *name) {
+        if (!Profiler::enabled()) {
+            // pushed as a value, push_back(ZONES) would need an out-of-class definition to link
+            m_Open.push_back((unsigned int)ZONES);
+            return;
+        }
+        Zone &zone = m_Zones[m_Next];
+        // the ring wrapped onto a zone the GPU has not finished yet
+        if (zone.pending)
+            read(zone);
+        zone.name = name;
+        glQueryCounter(zone.queries[0].get(), GL_TIMESTAMP);
+        m_Open.push_back(m_Next);
+        m_Next = (m_Next + 1) % ZONES;
+    }
+
+    void end() {
+        if (m_Open.empty())
+            return;
+        unsigned int index = m_Open.back();
+        m_Open.pop_back();
+        if (index == ZONES)
+            return;
+        glQueryCounter(m_Zones[index].queries[1].get(), GL_TIMESTAMP);
+        m_Zones[index].pending = true;
+    }
+};
+
+#endif //PROJECT_BASE_GPUPROFILER_H
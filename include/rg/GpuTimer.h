@@ -0,0 +1,78 @@
+//
+// GPU timer backed by a small ring of GL_TIMESTAMP query pairs, so reading a
+// result never waits for the GPU to catch up with the frame that issued it.
+// Timestamps rather than GL_TIME_ELAPSED, because elapsed-time queries cannot
+// nest and a pass timer has to run around the timers inside the pass.
+//
+
+#ifndef PROJECT_BASE_GPUTIMER_H
+#define PROJECT_BASE_GPUTIMER_H
+
+#include <glad/glad.h>
+#include <rg/GLHandle.h>
+
+class GpuTimer {
+    static const unsigned int QUERIES = 4;
+    GLQuery m_Queries[QUERIES][2];
+    bool m_Pending[QUERIES] = {};
+    unsigned int m_Next = 0;
+    double m_LastMs = 0.0;
+    double m_AverageMs = 0.0;
+    unsigned long m_Samples = 0;
+
+    void collect(unsigned int slot, bool wait) {
+        if (!m_Pending[slot])
+            return;
+        GLint available = 0;
+        glGetQueryObjectiv(m_Queries[slot][1].get(), GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait)
+            return;
+        GLuint64 start = 0, end = 0;
+        glGetQueryObjectui64v(m_Queries[slot][0].get(), GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(m_Queries[slot][1].get(), GL_QUERY_RESULT, &end);
+        m_Pending[slot] = false;
+        m_LastMs = end > start ? (end - start) / 1.0e6 : 0.0;
+        // exponential moving average, seeded with the first sample
+        m_AverageMs = m_Samples == 0 ? m_LastMs : m_AverageMs * 0.95 + m_LastMs * 0.05;
+        m_Samples++;
+    }
+
+public:
+    GpuTimer() {
+        for (auto &pair : m_Queries)
+            for (auto &query : pair)
+                query = GLQuery::create();
+    }
+
+    GpuTimer(const GpuTimer &) = delete;
+    GpuTimer &operator=(const GpuTimer &) = delete;
+
+    void begin() {
+        // pick up whatever finished since last time, only block if the ring wrapped around
+        for (unsigned int i = 0; i < QUERIES; i++)
+            collect(i, false);
+        collect(m_Next, true);
+        glQueryCounter(m_Queries[m_Next][0].get(), GL_TIMESTAMP);
+    }
+
+    void end() {
+        glQueryCounter(m_Queries[m_Next][1].get(), GL_TIMESTAMP);
+        m_Pending[m_Next] = true;
+        m_Next = (m_Next + 1) % QUERIES;
+    }
+
+    // most recent result, a few frames old
+    double lastMs() const {
+        return m_LastMs;
+    }
+
+    double averageMs() const {
+        return m_AverageMs;
+    }
+
+    unsigned long samples() const {
+        return m_Samples;
+    }
+};
+
+#endif //PROJECT_BASE_GPUTIMER_H
@@ -0,0 +1,305 @@
+//
+// Particles that live entirely on the GPU. The state is two buffers used in
+// turn: each update reads one through transform feedback, integrates every
+// particle in the vertex shader and lets the geometry shader drop the dead
+// ones, so the other buffer receives the survivors packed together. New
+// particles are spawned in the same feedback session by attribute-less draws,
+// one vertex per particle, and appended behind them.
+//
+// With GL 4.0 / ARB_transform_feedback2 the particle count never comes back
+// to the CPU: the next update and the draw take it straight from the feedback
+// object. On plain 3.3 it is read from a query after every update.
+//
+// The particles are drawn as additive point sprites, which needs no sorting.
+//
+
+#ifndef PROJECT_BASE_PARTICLESYSTEM_H
+#define PROJECT_BASE_PARTICLESYSTEM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/Shader.h>
+
+#ifndef GL_TRANSFORM_FEEDBACK
+#define GL_TRANSFORM_FEEDBACK 0x8E22
+#endif
+
+class ParticleSystem {
+public:
+    static const unsigned int KINDS = 3;
+
+    enum Shape {
+        SPHERE,
+        BOX
+    };
+
+    struct Emitter {
+        Shape shape = SPHERE;
+        glm::vec3 position = glm::vec3(0.0f);
+        // radius of a sphere in x, half size of a box
+        glm::vec3 extent = glm::vec3(1.0f);
+        glm::vec3 velocity = glm::vec3(0.0f);
+        // random speed away from the emitter centre, added to velocity
+        float speed = 0.0f;
+        // lifetime range in seconds
+        glm::vec2 life = glm::vec2(1.0f);
+        // particles per second
+        float rate = 0.0f;
+        unsigned int kind = 0;
+        // fraction of a particle carried over to the next update
+        float pending = 0.0f;
+    };
+
+private:
+    // one transform feedback vertex; age and lifetime ride in the w components
+    struct Particle {
+        glm::vec4 position;
+        glm::vec4 velocity;
+        float kind;
+    };
+    static_assert(sizeof(Particle) == 36, "Particle must match the interleaved feedback varyings");
+
+    typedef void (APIENTRYP BindTransformFeedbackProc)(GLenum target, GLuint id);
+    typedef void (APIENTRYP DrawTransformFeedbackProc)(GLenum mode, GLuint id);
+
+    struct Procs {
+        BindTransformFeedbackProc bind = nullptr;
+        DrawTransformFeedbackProc draw = nullptr;
+    };
+
+    static Procs &procs() {
+        static Procs procs;
+        return procs;
+    }
+
+    Shader m_Update;
+    Shader m_Render;
+    GLBuffer m_Buffers[2];
+    GLVertexArray m_Vaos[2];
+    GLTransformFeedback m_Feedback[2];
+    GLVertexArray m_EmitVao;
+    GLQuery m_Query;
+    unsigned int m_Capacity;
+    // buffer holding the live particles
+    unsigned int m_Current = 0;
+    bool m_HasState = false;
+    bool m_QueryPending = false;
+    GLuint m_Count = 0;
+    int m_Seed = 0;
+    bool m_Enabled = true;
+
+    std::vector<Emitter> m_Emitters;
+    glm::vec4 m_Look[KINDS];
+    float m_Drag[KINDS];
+
+    bool feedbackObjects() const {
+        return procs().bind != nullptr;
+    }
+
+    void drawCurrent() const {
+        if (feedbackObjects())
+            procs().draw(GL_POINTS, m_Feedback[m_Current].get());
+        else if (m_Count > 0)
+            glDrawArrays(GL_POINTS, 0, (GLsizei)m_Count);
+    }
+
+public:
+    // call once a context is current, after GLDeletionQueue::loadExtensions and before creating a particle system
+    static void loadExtensions(GLADloadproc load) {
+        if (!GLDeletionQueue::supported(GLObjectType::TRANSFORM_FEEDBACK))
+            return;
+        Procs &p = procs();
+        p.bind = (BindTransformFeedbackProc)load("glBindTransformFeedback");
+        p.draw = (DrawTransformFeedbackProc)load("glDrawTransformFeedback");
+        if (p.bind == nullptr || p.draw == nullptr)
+            p = Procs();
+    }
+
+    explicit ParticleSystem(unsigned int capacity)
+            : m_Update("resources/shaders/particles_update.vs", "resources/shaders/particles_update.fs",
+                       "resources/shaders/particles_update.gs", {}, {"outPosition", "outVelocity", "outKind"}),
+              m_Render("resources/shaders/particles.vs", "resources/shaders/particles.fs"),
+              m_Capacity(std::max(1u, capacity)) {
+        for (unsigned int k = 0; k < KINDS; k++) {
+            m_Look[k] = glm::vec4(1.0f, 1.0f, 1.0f, 0.05f);
+            m_Drag[k] = 0.0f;
+        }
+
+        GL_MEMORY_OWNER("particles");
+        for (unsigned int i = 0; i < 2; i++) {
+            m_Buffers[i] = GLBuffer::create();
+            m_Vaos[i] = GLVertexArray::create();
+            glBindVertexArray(m_Vaos[i].get());
+            glBindBuffer(GL_ARRAY_BUFFER, m_Buffers[i].get());
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)m_Capacity * sizeof(Particle), NULL, GL_DYNAMIC_COPY);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, position));
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, velocity));
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void *)offsetof(Particle, kind));
+        }
+        GLDebug::label(GL_BUFFER, m_Buffers[0].get(), "particles A");
+        GLDebug::label(GL_BUFFER, m_Buffers[1].get(), "particles B");
+        // spawning reads no attributes, but core profiles still want a vertex array bound
+        m_EmitVao = GLVertexArray::create();
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        if (feedbackObjects()) {
+            for (unsigned int i = 0; i < 2; i++) {
+                m_Feedback[i] = GLTransformFeedback::create();
+                procs().bind(GL_TRANSFORM_FEEDBACK, m_Feedback[i].get());
+                glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Buffers[i].get());
+            }
+            procs().bind(GL_TRANSFORM_FEEDBACK, 0);
+        }
+        m_Query = GLQuery::create();
+    }
+
+    ParticleSystem(const ParticleSystem &) = delete;
+    ParticleSystem &operator=(const ParticleSystem &) = delete;
+
+    ~ParticleSystem() {
+        m_Update.deleteProgram();
+        m_Render.deleteProgram();
+    }
+
+    void setEnabled(bool enabled) {
+        m_Enabled = enabled;
+    }
+
+    bool enabled() const {
+        return m_Enabled;
+    }
+
+    unsigned int capacity() const {
+        return m_Capacity;
+    }
+
+    // live particles after the last update whose count has come back; a few frames old with feedback objects
+    unsigned int alive() const {
+        return m_Count;
+    }
+
+    bool gpuDriven() const {
+        return feedbackObjects();
+    }
+
+    // colour is premultiplied intensity, size the sprite diameter in world units, drag per second
+    void setKind(unsigned int kind, const glm::vec3 &color, float size, float drag) {
+        m_Look[kind] = glm::vec4(color, size);
+        m_Drag[kind] = drag;
+    }
+
+    unsigned int addEmitter(const Emitter &emitter) {
+        m_Emitters.push_back(emitter);
+        return (unsigned int)m_Emitters.size() - 1;
+    }
+
+    Emitter &emitter(unsigned int index) {
+        return m_Emitters[index];
+    }
+
+    // advances every particle by dt seconds and spawns what the emitters produced meanwhile
+    void update(float dt) {
+        if (!m_Enabled || dt <= 0.0f)
+            return;
+        if (m_QueryPending) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(m_Query.get(), GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                glGetQueryObjectuiv(m_Query.get(), GL_QUERY_RESULT, &m_Count);
+                m_QueryPending = false;
+            }
+        }
+
+        m_Update.use();
+        m_Update.setFloat("deltaTime", dt);
+        m_Update.setFloatArray("drag", m_Drag, KINDS);
+
+        unsigned int target = 1 - m_Current;
+        glEnable(GL_RASTERIZER_DISCARD);
+        if (feedbackObjects())
+            procs().bind(GL_TRANSFORM_FEEDBACK, m_Feedback[target].get());
+        else
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Buffers[target].get());
+        bool counting = !m_QueryPending;
+        if (counting)
+            glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, m_Query.get());
+        glBeginTransformFeedback(GL_POINTS);
+
+        if (m_HasState) {
+            m_Update.setBool("emitting", false);
+            glBindVertexArray(m_Vaos[m_Current].get());
+            drawCurrent();
+        }
+
+        // whatever does not fit behind the survivors is dropped by the feedback itself
+        m_Update.setBool("emitting", true);
+        glBindVertexArray(m_EmitVao.get());
+        for (Emitter &e : m_Emitters) {
+            e.pending += e.rate * dt;
+            float spawn = std::min(std::floor(e.pending), (float)m_Capacity);
+            e.pending -= spawn;
+            if (spawn < 1.0f)
+                continue;
+            m_Update.setInt("seed", m_Seed++);
+            m_Update.setInt("emitterShape", e.shape);
+            m_Update.setVec3("emitterPosition", e.position);
+            m_Update.setVec3("emitterExtent", e.extent);
+            m_Update.setVec3("emitterVelocity", e.velocity);
+            m_Update.setFloat("emitterSpeed", e.speed);
+            m_Update.setVec2("emitterLife", e.life);
+            m_Update.setFloat("emitterKind", (float)e.kind);
+            glDrawArrays(GL_POINTS, 0, (GLsizei)spawn);
+        }
+
+        glEndTransformFeedback();
+        if (counting)
+            glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        if (feedbackObjects())
+            procs().bind(GL_TRANSFORM_FEEDBACK, 0);
+        else
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(0);
+        m_Current = target;
+        m_HasState = true;
+
+        // without feedback objects the next draw needs the count, which waits for this update
+        if (counting && !feedbackObjects())
+            glGetQueryObjectuiv(m_Query.get(), GL_QUERY_RESULT, &m_Count);
+        else if (counting)
+            m_QueryPending = true;
+    }
+
+    // pointScale turns a world size at distance 1 into pixels, projection[1][1] * target height / 2
+    void render(const glm::mat4 &viewProjection, float pointScale) {
+        if (!m_Enabled || !m_HasState)
+            return;
+        m_Render.use();
+        m_Render.setMat4("viewProjection", viewProjection);
+        m_Render.setFloat("pointScale", pointScale);
+        m_Render.setVec4Array("look", m_Look, KINDS);
+
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glDepthMask(GL_FALSE);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBindVertexArray(m_Vaos[m_Current].get());
+        drawCurrent();
+        glBindVertexArray(0);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+};
+
+#endif //PROJECT_BASE_PARTICLESYSTEM_H
@@ -0,0 +1,150 @@
+//
+// Performance overlay drawn with Dear ImGui on top of the finished frame. Only
+// the OpenGL backend is used: the overlay takes no input, so it can live on the
+// render thread without touching GLFW. While hidden it does no work at all.
+//
+
+#ifndef PROJECT_BASE_PERFOVERLAY_H
+#define PROJECT_BASE_PERFOVERLAY_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <imgui.h>
+#include <imgui_impl_opengl3.h>
+#include <rg/GpuTimer.h>
+#include <rg/GLStats.h>
+
+class PerfOverlay {
+public:
+    struct PassTiming {
+        // frame graph pass names are literals
+        const char *name;
+        double cpuMs;
+        double gpuMs;
+    };
+
+    // everything shown besides the frame-time graph, gathered by the renderer
+    struct Stats {
+        std::vector<PassTiming> passes;
+        GLStats::Counters counters;
+        unsigned int queueDraws = 0;
+        unsigned int programBinds = 0;
+        unsigned int materialBinds = 0;
+        size_t targetBytes = 0;
+        // everything GLMemory tracks, -1 when it is not installed
+        long long glObjectBytes = -1;
+        // -1 when the driver does not report it
+        long long freeVramKb = -1;
+        float resolutionScale = 1.0f;
+    };
+
+private:
+    static const int HISTORY = 120;
+
+    bool m_Visible = false;
+    float m_FrameMs[HISTORY] = {};
+    int m_Next = 0;
+    GpuTimer m_Timer;
+    double m_CpuMs = 0.0;
+
+public:
+    PerfOverlay() {
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        io.IniFilename = nullptr;
+        ImGui::StyleColorsDark();
+        ImGui_ImplOpenGL3_Init("#version 330 core");
+    }
+
+    PerfOverlay(const PerfOverlay &) = delete;
+    PerfOverlay &operator=(const PerfOverlay &) = delete;
+
+    ~PerfOverlay() {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui::DestroyContext();
+    }
+
+    void toggle() {
+        m_Visible = !m_Visible;
+        if (m_Visible)
+            GLStats::install();
+        else
+            GLStats::uninstall();
+    }
+
+    bool visible() const {
+        return m_Visible;
+    }
+
+    // the overlay's own cost from the last time it was drawn
+    double cpuMs() const {
+        return m_CpuMs;
+    }
+
+    double gpuMs() const {
+        return m_Timer.lastMs();
+    }
+
+    // records the frame time every frame so the graph has history when it is opened
+    void addFrame(float frameMs) {
+        m_FrameMs[m_Next] = frameMs;
+        m_Next = (m_Next + 1) % HISTORY;
+    }
+
+    // draws into the currently bound framebuffer
+    void render(const Stats &stats, int width, int height, float deltaTime) {
+        if (!m_Visible)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        m_Timer.begin();
+
+        ImGuiIO &io = ImGui::GetIO();
+        io.DisplaySize = ImVec2((float)width, (float)height);
+        io.DeltaTime = deltaTime > 0.0f ? deltaTime : 1.0f / 60.0f;
+        ImGui_ImplOpenGL3_NewFrame();
+        ImGui::NewFrame();
+
+        ImGui::SetNextWindowPos(ImVec2(10.0f, 10.0f));
+        ImGui::SetNextWindowBgAlpha(0.6f);
+        ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize |
+                                 ImGuiWindowFlags_NoInputs | ImGuiWindowFlags_NoSavedSettings;
+        ImGui::Begin("performance", nullptr, flags);
+
+        float latest = m_FrameMs[(m_Next + HISTORY - 1) % HISTORY];
+        char overlay[32];
+        std::snprintf(overlay, sizeof(overlay), "%.2f ms", latest);
+        ImGui::PlotLines("##frame", m_FrameMs, HISTORY, m_Next, overlay, 0.0f, 50.0f, ImVec2(240.0f, 60.0f));
+
+        ImGui::Text("%-10s %8s %8s", "pass", "cpu ms", "gpu ms");
+        for (const auto &pass : stats.passes)
+            ImGui::Text("%-10s %8.3f %8.3f", pass.name, pass.cpuMs, pass.gpuMs);
+        ImGui::Text("%-10s %8.3f %8.3f", "overlay", m_CpuMs, m_Timer.lastMs());
+        ImGui::Separator();
+
+        ImGui::Text("draw calls      %lu", stats.counters.drawCalls);
+        ImGui::Text("triangles       %lu", stats.counters.triangles);
+        ImGui::Text("state changes   %lu", stats.counters.stateChanges);
+        ImGui::Text("  queue binds   %u program, %u material", stats.programBinds, stats.materialBinds);
+        ImGui::Text("uniform uploads %lu", stats.counters.uniformUploads);
+        ImGui::Text("queued draws    %u", stats.queueDraws);
+        ImGui::Separator();
+        ImGui::Text("render targets  %.1f MB", stats.targetBytes / (1024.0 * 1024.0));
+        if (stats.glObjectBytes >= 0)
+            ImGui::Text("gl objects      %.1f MB", stats.glObjectBytes / (1024.0 * 1024.0));
+        if (stats.freeVramKb >= 0)
+            ImGui::Text("free vram       %.1f MB", stats.freeVramKb / 1024.0);
+        ImGui::Text("resolution      %.0f%%", stats.resolutionScale * 100.0f);
+
+        ImGui::End();
+        ImGui::Render();
+        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+        m_Timer.end();
+        m_CpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#endif //PROJECT_BASE_PERFOVERLAY_H
@@ -0,0 +1,263 @@
+//
+// Omnidirectional shadows for a point light, all six faces of a depth cube map
+// rendered in one pass through a layered framebuffer. Every caster is drawn
+// once: its bounding sphere is tested against the six face frusta and only the
+// faces it touches are listed for the shader, which routes each copy of the
+// geometry to its face with gl_Layer.
+//
+// Where the vertex shader may write gl_Layer, the copies are instances and no
+// geometry shader runs. Otherwise a geometry shader emits them, with one
+// invocation per face on GL 4.0 / ARB_gpu_shader5 and a loop on plain 3.3.
+//
+// The cube stores distance to the light over the far plane, so receivers
+// compare against length(fragPos - lightPos) / far.
+//
+
+#ifndef PROJECT_BASE_POINTSHADOWS_H
+#define PROJECT_BASE_POINTSHADOWS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/Shader.h>
+
+class PointShadows {
+public:
+    enum Path {
+        AUTO,
+        VERTEX_LAYER,
+        GEOMETRY_INVOCATIONS,
+        GEOMETRY_LOOP
+    };
+
+private:
+    Path m_Path;
+    Shader m_Depth;
+    GLTexture m_Cube;
+    GLFramebuffer m_Fbo;
+    int m_Size;
+    float m_Near;
+    float m_Far;
+    bool m_Enabled = true;
+
+    glm::vec3 m_Position = glm::vec3(0.0f);
+    glm::mat4 m_Faces[6];
+    unsigned long m_Casters = 0;
+    unsigned long m_FaceDraws = 0;
+
+    static bool hasExtension(const char *extension) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name != nullptr && std::strcmp(name, extension) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    static Path choosePath(Path preferred) {
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        // the ARB extension is written against 4.1, the AMD one works on 3.x
+        bool vertexLayer = hasExtension("GL_AMD_vertex_shader_layer") ||
+                           (major * 10 + minor >= 41 && hasExtension("GL_ARB_shader_viewport_layer_array"));
+        bool invocations = major >= 4 || hasExtension("GL_ARB_gpu_shader5");
+
+        if (preferred == VERTEX_LAYER && vertexLayer)
+            return VERTEX_LAYER;
+        if (preferred == GEOMETRY_INVOCATIONS && invocations)
+            return GEOMETRY_INVOCATIONS;
+        if (preferred == GEOMETRY_LOOP)
+            return GEOMETRY_LOOP;
+        if (vertexLayer)
+            return VERTEX_LAYER;
+        return invocations ? GEOMETRY_INVOCATIONS : GEOMETRY_LOOP;
+    }
+
+    static std::string geometryShader(Path path) {
+        return path == VERTEX_LAYER ? "" : "resources/shaders/shadow_cube.gs";
+    }
+
+    static std::vector<std::string> defines(Path path) {
+        switch (path) {
+            case VERTEX_LAYER: return {"VERTEX_LAYER"};
+            case GEOMETRY_INVOCATIONS: return {"INVOCATIONS"};
+            default: return {};
+        }
+    }
+
+public:
+    PointShadows(int size, float near, float far, Path preferred = AUTO)
+            : m_Path(choosePath(preferred)),
+              m_Depth("resources/shaders/shadow_cube.vs", "resources/shaders/shadow_cube.fs",
+                      geometryShader(m_Path), defines(m_Path)),
+              m_Size(size), m_Near(near), m_Far(far) {
+        GL_MEMORY_OWNER("point shadows");
+        m_Cube = GLTexture::create();
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_Cube.get());
+        for (unsigned int face = 0; face < 6; face++)
+            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_DEPTH_COMPONENT24, size, size, 0,
+                         GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        GLDebug::label(GL_TEXTURE, m_Cube.get(), "point light shadows");
+
+        // all six faces attached at once, gl_Layer picks the face
+        m_Fbo = GLFramebuffer::create();
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo.get());
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Cube.get(), 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "Point shadow framebuffer is incomplete!");
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    PointShadows(const PointShadows &) = delete;
+    PointShadows &operator=(const PointShadows &) = delete;
+
+    ~PointShadows() {
+        m_Depth.deleteProgram();
+    }
+
+    static const char *pathName(Path path) {
+        switch (path) {
+            case VERTEX_LAYER: return "instanced, gl_Layer from the vertex shader";
+            case GEOMETRY_INVOCATIONS: return "geometry shader, one invocation per face";
+            case GEOMETRY_LOOP: return "geometry shader, loop over faces";
+            default: return "auto";
+        }
+    }
+
+    Path path() const {
+        return m_Path;
+    }
+
+    void setEnabled(bool enabled) {
+        m_Enabled = enabled;
+    }
+
+    bool enabled() const {
+        return m_Enabled;
+    }
+
+    float farPlane() const {
+        return m_Far;
+    }
+
+    unsigned int texture() const {
+        return m_Cube.get();
+    }
+
+    int size() const {
+        return m_Size;
+    }
+
+    // casters drawn and faces they went to in the last pass; six per caster without the face culling
+    unsigned long casters() const {
+        return m_Casters;
+    }
+
+    unsigned long faceDraws() const {
+        return m_FaceDraws;
+    }
+
+    // starts the pass for a light at position; leaves the shadow framebuffer bound
+    void begin(const glm::vec3 &position) {
+        static const glm::vec3 directions[6] = {
+                glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+                glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f)};
+        static const glm::vec3 ups[6] = {
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+                glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+
+        m_Position = position;
+        m_Casters = 0;
+        m_FaceDraws = 0;
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, m_Near, m_Far);
+        for (unsigned int face = 0; face < 6; face++)
+            m_Faces[face] = projection * glm::lookAt(position, position + directions[face], ups[face]);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Fbo.get());
+        glViewport(0, 0, m_Size, m_Size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_CULL_FACE);
+        m_Depth.use();
+        m_Depth.setMat4Array("faceMatrices", m_Faces, 6);
+        m_Depth.setVec3("lightPos", position);
+        m_Depth.setFloat("farPlane", m_Far);
+    }
+
+    // faces of a cube map around light, out to range, whose 90 degree frustum the sphere reaches, as a list of
+    // layer indices
+    static unsigned int touchedFaces(const glm::vec3 &light, float range, const glm::vec3 &center, float radius,
+                                     int faces[6]) {
+        glm::vec3 p = center - light;
+        if (glm::length(p) - radius > range)
+            return 0;
+        const float invSqrt2 = 0.70710678f;
+        unsigned int count = 0;
+        for (int face = 0; face < 6; face++) {
+            int axis = face / 2;
+            float along = (face % 2 == 0) ? p[axis] : -p[axis];
+            float u = p[(axis + 1) % 3];
+            float v = p[(axis + 2) % 3];
+            // the four side planes pass through the light at 45 degrees to the face axis
+            if (along + radius < 0.0f || (along - u) * invSqrt2 < -radius || (along + u) * invSqrt2 < -radius ||
+                (along - v) * invSqrt2 < -radius || (along + v) * invSqrt2 < -radius)
+                continue;
+            faces[count++] = face;
+        }
+        return count;
+    }
+
+    // radius bounds the caster's geometry in model space; submit issues the draw with the instance count it is given
+    template <typename Submit>
+    bool draw(const glm::mat4 &model, float radius, Submit submit) {
+        float scale = std::max(glm::length(glm::vec3(model[0])),
+                               std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        int faces[6];
+        unsigned int count = touchedFaces(m_Position, m_Far, glm::vec3(model[3]), radius * scale, faces);
+        if (count == 0)
+            return false;
+        m_Depth.setMat4("model", model);
+        m_Depth.setIntArray("faces", faces, (int)count);
+        m_Depth.setInt("faceCount", (int)count);
+        submit((GLsizei)(m_Path == VERTEX_LAYER ? count : 1));
+        m_Casters++;
+        m_FaceDraws += count;
+        return true;
+    }
+
+    void end() {
+        glEnable(GL_CULL_FACE);
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    void bind(GLenum unit) const {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_Cube.get());
+        glActiveTexture(GL_TEXTURE0);
+    }
+};
+
+#endif //PROJECT_BASE_POINTSHADOWS_H
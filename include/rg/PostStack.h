@@ -0,0 +1,187 @@
+//
+// Post-processing stack fused into a single full-screen fragment pass. Every
+// enabled stage is compiled into one permutation of post.fs, so adding an
+// effect costs ALU in the existing pass instead of another read and write of
+// the whole framebuffer.
+//
+
+#ifndef PROJECT_BASE_POSTSTACK_H
+#define PROJECT_BASE_POSTSTACK_H
+
+#include <cctype>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/Shader.h>
+#include <rg/GpuTimer.h>
+
+class PostStack {
+public:
+    // tonemapping and gamma always run, these are the optional stages
+    enum Stage {
+        GRADING,
+        VIGNETTE,
+        FXAA,
+        DITHER,
+        STAGE_COUNT
+    };
+
+    static const char *stageName(unsigned int stage) {
+        static const char *names[STAGE_COUNT] = {"grading", "vignette", "fxaa", "dither"};
+        return stage < STAGE_COUNT ? names[stage] : "tonemap";
+    }
+
+private:
+    static const unsigned int PERMUTATIONS = 1u << STAGE_COUNT;
+
+    Shader *m_Programs[PERMUTATIONS] = {};
+    unsigned int m_Mask = (1u << GRADING) | (1u << DITHER);
+
+    // profiling draws one variant of the pass before the real one, cycling through
+    // "all enabled stages but s" for every s and finally the bare tonemap pass
+    bool m_Profiling = false;
+    unsigned int m_ProfileVariant = 0;
+    GpuTimer m_FullTimer;
+    GpuTimer m_VariantTimers[STAGE_COUNT + 1];
+    unsigned int m_VariantMasks[STAGE_COUNT + 1] = {};
+
+    glm::vec3 m_Tint = glm::vec3(1.0f, 0.97f, 0.92f);
+    float m_Saturation = 1.1f;
+    float m_Contrast = 1.05f;
+    float m_VignetteStrength = 0.6f;
+
+    Shader &program(unsigned int mask) {
+        if (m_Programs[mask] == nullptr) {
+            std::vector<std::string> defines;
+            for (unsigned int s = 0; s < STAGE_COUNT; s++) {
+                if (mask & (1u << s)) {
+                    std::string name = stageName(s);
+                    for (auto &ch : name)
+                        ch = (char)toupper(ch);
+                    defines.push_back("STAGE_" + name);
+                }
+            }
+            m_Programs[mask] = new Shader("resources/shaders/post.vs", "resources/shaders/post.fs", "", defines);
+            m_Programs[mask]->use();
+            m_Programs[mask]->setInt("hdrBuffer", 0);
+            m_Programs[mask]->setInt("bloomBlur", 1);
+        }
+        return *m_Programs[mask];
+    }
+
+    // compiles every program render() will draw, so the frame that changes the mask or turns profiling on pays
+    // for it instead of the steady frames after it
+    void prepare() {
+        program(m_Mask);
+        if (m_Profiling)
+            for (unsigned int variant = 0; variant <= STAGE_COUNT; variant++)
+                program(variant < STAGE_COUNT ? m_Mask & ~(1u << variant) : 0);
+    }
+
+    void draw(unsigned int mask, bool bloom, float bloomStrength, float exposure) {
+        Shader &shader = program(mask);
+        shader.use();
+        shader.setInt("bloom", bloom);
+        shader.setFloat("bloomStrength", bloomStrength);
+        shader.setFloat("exposure", exposure);
+        shader.setVec3("tint", m_Tint);
+        shader.setFloat("saturation", m_Saturation);
+        shader.setFloat("contrast", m_Contrast);
+        shader.setFloat("vignetteStrength", m_VignetteStrength);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    }
+
+public:
+    PostStack() = default;
+
+    PostStack(const PostStack &) = delete;
+    PostStack &operator=(const PostStack &) = delete;
+
+    ~PostStack() {
+        for (auto program : m_Programs) {
+            if (program != nullptr) {
+                program->deleteProgram();
+                delete program;
+            }
+        }
+    }
+
+    void toggle(Stage stage) {
+        m_Mask ^= 1u << stage;
+        prepare();
+    }
+
+    bool enabled(Stage stage) const {
+        return (m_Mask & (1u << stage)) != 0;
+    }
+
+    void setProfiling(bool profiling) {
+        m_Profiling = profiling;
+        prepare();
+    }
+
+    bool profiling() const {
+        return m_Profiling;
+    }
+
+    // resolves hdrTexture (plus bloomTexture when bloom is on) into the bound framebuffer
+    void render(unsigned int hdrTexture, unsigned int bloomTexture, bool bloom, float bloomStrength,
+                float exposure, unsigned int quadVAO) {
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(quadVAO);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, hdrTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, bloom ? bloomTexture : 0);
+
+        // the variant is overwritten by the real pass right after, so it never shows up on screen
+        if (m_Profiling) {
+            unsigned int variant = m_ProfileVariant;
+            unsigned int mask = variant < STAGE_COUNT ? m_Mask & ~(1u << variant) : 0;
+            m_VariantMasks[variant] = mask;
+            m_VariantTimers[variant].begin();
+            draw(mask, bloom, bloomStrength, exposure);
+            m_VariantTimers[variant].end();
+            m_ProfileVariant = (m_ProfileVariant + 1) % (STAGE_COUNT + 1);
+        }
+
+        m_FullTimer.begin();
+        draw(m_Mask, bloom, bloomStrength, exposure);
+        m_FullTimer.end();
+
+        glActiveTexture(GL_TEXTURE0);
+        if (depthTest)
+            glEnable(GL_DEPTH_TEST);
+    }
+
+    // GPU time of the fused pass, a few frames old
+    double gpuMs() const {
+        return m_FullTimer.lastMs();
+    }
+
+    // each stage costs the difference between the full pass and the pass without it
+    void report() const {
+        std::cout << "post stack: " << m_FullTimer.averageMs() << " ms gpu" << std::endl;
+        if (!m_Profiling) {
+            std::cout << "  per-stage costs need profiling enabled" << std::endl;
+            return;
+        }
+        for (unsigned int s = 0; s <= STAGE_COUNT; s++) {
+            std::cout << "  " << stageName(s) << ": ";
+            const GpuTimer &timer = m_VariantTimers[s];
+            if (s < STAGE_COUNT && !(m_Mask & (1u << s)))
+                std::cout << "off" << std::endl;
+            else if (timer.samples() == 0 || (s < STAGE_COUNT && m_VariantMasks[s] != (m_Mask & ~(1u << s))))
+                std::cout << "not measured" << std::endl;
+            else if (s < STAGE_COUNT)
+                std::cout << m_FullTimer.averageMs() - timer.averageMs() << " ms" << std::endl;
+            else
+                std::cout << timer.averageMs() << " ms" << std::endl;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_POSTSTACK_H
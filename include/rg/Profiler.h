@@ -0,0 +1,168 @@
+//
+// Scoped CPU profiler. Every thread records zones into its own fixed ring, so
+// recording never locks; the rings are merged only when the trace is written
+// out in the Chrome trace event format (chrome://tracing, ui.perfetto.dev).
+// While profiling is off a zone costs one branch.
+//
+
+#ifndef PROJECT_BASE_PROFILER_H
+#define PROJECT_BASE_PROFILER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Profiler {
+public:
+    struct Event {
+        const char *name;
+        uint64_t start;
+        uint64_t end;
+    };
+
+    // one timeline in the trace: a thread, or the GPU
+    struct Track {
+        static const uint64_t CAPACITY = 1 << 16;
+        std::string name;
+        unsigned int id;
+        Event events[CAPACITY];
+        std::atomic<uint64_t> written{0};
+
+        // only the owning thread records; older events are overwritten once the ring is full
+        void record(const char *name, uint64_t start, uint64_t end) {
+            uint64_t n = written.load(std::memory_order_relaxed);
+            events[n & (CAPACITY - 1)] = Event{name, start, end};
+            written.store(n + 1, std::memory_order_release);
+        }
+    };
+
+    static bool enabled() {
+        return flag().load(std::memory_order_relaxed);
+    }
+
+    static void setEnabled(bool enabled) {
+        flag().store(enabled, std::memory_order_relaxed);
+    }
+
+    // nanoseconds on the steady clock shared by all tracks
+    static uint64_t now() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // the calling thread's track, registered on first use
+    static Track &thread() {
+        static thread_local Track *track = nullptr;
+        if (track == nullptr)
+            track = &addTrack("thread");
+        return *track;
+    }
+
+    static void setThreadName(const char *name) {
+        thread().name = name;
+    }
+
+    // a track not tied to a thread, only one thread may record into it
+    static Track &addTrack(const char *name) {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        auto &tracks = registry();
+        tracks.emplace_back(new Track());
+        tracks.back()->name = name;
+        tracks.back()->id = (unsigned int)tracks.size();
+        return *tracks.back();
+    }
+
+    static uint64_t eventCount() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        uint64_t count = 0;
+        for (auto &track : registry())
+            count += std::min(track->written.load(std::memory_order_acquire), (uint64_t)Track::CAPACITY);
+        return count;
+    }
+
+    // writes every track as complete ("X") events. Tracks are read without locks, so
+    // call it only after every recording thread has stopped, e.g. been joined:
+    // a full ring overwrites the slot that is being read
+    static bool writeChromeTrace(const std::string &path) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        uint64_t origin = ~0ull;
+        for (auto &track : registry()) {
+            uint64_t written = track->written.load(std::memory_order_acquire);
+            for (uint64_t i = written > Track::CAPACITY ? written - Track::CAPACITY : 0; i < written; i++)
+                origin = std::min(origin, track->events[i & (Track::CAPACITY - 1)].start);
+        }
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (auto &track : registry()) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << track->id
+                << ",\"args\":{\"name\":\"" << track->name << "\"}}";
+            first = false;
+            uint64_t written = track->written.load(std::memory_order_acquire);
+            for (uint64_t i = written > Track::CAPACITY ? written - Track::CAPACITY : 0; i < written; i++) {
+                const Event &e = track->events[i & (Track::CAPACITY - 1)];
+                out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id
+                    << ",\"ts\":" << (e.start - origin) / 1000.0 << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+            }
+        }
+        out << "\n]}\n";
+        return true;
+    }
+
+private:
+    static std::atomic<bool> &flag() {
+        static std::atomic<bool> flag{false};
+        return flag;
+    }
+
+    static std::vector<std::unique_ptr<Track>> &registry() {
+        static std::vector<std::unique_ptr<Track>> tracks;
+        return tracks;
+    }
+
+    static std::mutex &registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+};
+
+class ProfileScope {
+    const char *m_Name;
+    uint64_t m_Start;
+
+public:
+    explicit ProfileScope(const char *name) : m_Name(Profiler::enabled() ? name : nullptr), m_Start(0) {
+        if (m_Name != nullptr)
+            m_Start = Profiler::now();
+    }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+    ~ProfileScope() {
+        end();
+    }
+
+    // closes the zone before the scope does
+    void end() {
+        if (m_Name != nullptr)
+            Profiler::thread().record(m_Name, m_Start, Profiler::now());
+        m_Name = nullptr;
+    }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+// name must outlive the trace, string literals are the usual choice
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+#endif //PROJECT_BASE_PROFILER_H
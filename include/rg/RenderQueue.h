@@ -0,0 +1,194 @@
+//
+// Sorted render queue. Every draw is submitted with a 64-bit key encoding its
+// pass, program, material and depth, the keys are radix-sorted once per frame
+// and the draws replayed in that order, so state is only switched when the
+// program or material actually changes. The callbacks of a frame live in the
+// queue's frame arena, so filling the queue does not allocate once it is warm.
+//
+
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <rg/Error.h>
+#include <rg/FrameArena.h>
+
+class RenderQueue {
+public:
+    // passes execute in this order; the skybox goes after the opaque geometry so it is
+    // only shaded where nothing was drawn, and before the transparent draws that blend over it
+    enum Pass {
+        OPAQUE = 0,
+        SKY = 1,
+        TRANSPARENT = 2
+    };
+
+    typedef FrameFunction<void()> Callback;
+
+private:
+    // key layout, most significant first:
+    //   opaque/sky:   pass:2 | program:8 | material:10 | depth:24 | sequence:20
+    //   transparent:  pass:2 | ~depth:24 | program:8 | material:10 | sequence:20
+    // so opaque draws are grouped by state and front to back inside a group, while
+    // transparent draws are strictly back to front
+    static const unsigned int SEQUENCE_BITS = 20;
+    static const unsigned int DEPTH_BITS = 24;
+    static const unsigned int MATERIAL_BITS = 10;
+    static const unsigned int PROGRAM_BITS = 8;
+
+    struct Item {
+        uint64_t key;
+        unsigned int draw;
+    };
+
+    struct Draw {
+        unsigned int program;
+        unsigned int material;
+        Callback callback;
+    };
+
+    FrameArena m_Arena;
+    std::vector<Callback> m_Programs;
+    std::vector<Callback> m_Materials;
+    Callback m_PassSetup[3];
+    std::vector<Draw> m_Draws;
+    std::vector<Item> m_Items;
+    std::vector<Item> m_Scratch;
+    float m_FarPlane;
+
+    unsigned int m_ProgramBinds = 0;
+    unsigned int m_MaterialBinds = 0;
+
+    uint64_t quantizeDepth(float depth) const {
+        float d = depth / m_FarPlane;
+        d = d < 0.0f ? 0.0f : (d > 1.0f ? 1.0f : d);
+        return (uint64_t)(d * (float)((1u << DEPTH_BITS) - 1));
+    }
+
+    // LSD radix sort over the key bytes; a byte that is equal for every item is skipped
+    void sort() {
+        m_Scratch.resize(m_Items.size());
+        for (unsigned int shift = 0; shift < 64; shift += 8) {
+            unsigned int counts[256] = {};
+            for (const auto &item : m_Items)
+                counts[(item.key >> shift) & 0xff]++;
+            if (counts[(m_Items[0].key >> shift) & 0xff] == m_Items.size())
+                continue;
+
+            unsigned int offset = 0;
+            for (auto &count : counts) {
+                unsigned int c = count;
+                count = offset;
+                offset += c;
+            }
+            for (const auto &item : m_Items)
+                m_Scratch[counts[(item.key >> shift) & 0xff]++] = item;
+            m_Items.swap(m_Scratch);
+        }
+    }
+
+public:
+    explicit RenderQueue(float farPlane) : m_FarPlane(farPlane) {
+    }
+
+    // forgets last frame's programs, materials, pass setups and draws, keeps the storage
+    void reset() {
+        m_Arena.reset();
+        for (auto &setup : m_PassSetup)
+            setup = Callback();
+        m_Programs.clear();
+        m_Materials.clear();
+        m_Draws.clear();
+        m_Items.clear();
+    }
+
+    // bind callbacks run when the sorted stream switches to the program/material;
+    // a material is rebound after every program switch, it may set program uniforms
+    template <typename F>
+    unsigned int addProgram(F &&bind) {
+        m_Programs.push_back(Callback(m_Arena, std::forward<F>(bind)));
+        return (unsigned int)m_Programs.size() - 1;
+    }
+
+    template <typename F>
+    unsigned int addMaterial(F &&bind) {
+        m_Materials.push_back(Callback(m_Arena, std::forward<F>(bind)));
+        return (unsigned int)m_Materials.size() - 1;
+    }
+
+    // runs before the first draw of a pass, for depth/cull/blend state
+    template <typename F>
+    void setPassSetup(Pass pass, F &&setup) {
+        m_PassSetup[pass] = Callback(m_Arena, std::forward<F>(setup));
+    }
+
+    // depth is the distance from the camera
+    template <typename F>
+    void submit(Pass pass, unsigned int program, unsigned int material, float depth, F &&draw) {
+        ASSERT(program < (1u << PROGRAM_BITS) && material < (1u << MATERIAL_BITS), "Render queue key overflow!");
+        uint64_t sequence = m_Draws.size() & ((1u << SEQUENCE_BITS) - 1);
+        uint64_t d = quantizeDepth(depth);
+        uint64_t key = (uint64_t)pass << 62;
+        if (pass == TRANSPARENT) {
+            key |= (((1u << DEPTH_BITS) - 1) - d) << 38;
+            key |= (uint64_t)program << 30;
+            key |= (uint64_t)material << SEQUENCE_BITS;
+        } else {
+            key |= (uint64_t)program << 54;
+            key |= (uint64_t)material << 44;
+            key |= d << SEQUENCE_BITS;
+        }
+        key |= sequence;
+
+        m_Items.push_back(Item{key, (unsigned int)m_Draws.size()});
+        m_Draws.push_back(Draw{program, material, Callback(m_Arena, std::forward<F>(draw))});
+    }
+
+    void execute() {
+        m_ProgramBinds = 0;
+        m_MaterialBinds = 0;
+        if (m_Items.empty())
+            return;
+        sort();
+
+        unsigned int pass = ~0u, program = ~0u, material = ~0u;
+        for (const auto &item : m_Items) {
+            const Draw &draw = m_Draws[item.draw];
+            unsigned int itemPass = (unsigned int)(item.key >> 62);
+            if (itemPass != pass) {
+                pass = itemPass;
+                if (m_PassSetup[pass])
+                    m_PassSetup[pass]();
+            }
+            if (draw.program != program) {
+                program = draw.program;
+                material = ~0u;
+                m_Programs[program]();
+                m_ProgramBinds++;
+            }
+            if (draw.material != material) {
+                material = draw.material;
+                m_Materials[material]();
+                m_MaterialBinds++;
+            }
+            draw.callback();
+        }
+    }
+
+    unsigned int drawCount() const {
+        return (unsigned int)m_Draws.size();
+    }
+
+    // state switches made by the last execute()
+    unsigned int programBinds() const {
+        return m_ProgramBinds;
+    }
+
+    unsigned int materialBinds() const {
+        return m_MaterialBinds;
+    }
+};
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
@@ -7,12 +7,35 @@
 #include <fstream>
 #include <sstream>
 #include <rg/Error.h>
+#include <rg/Profiler.h>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
 #include <common.h>
 #include <glm/glm.hpp>
+#include <vector>
 class Shader {
-    unsigned int m_Id;
+    GLProgram m_Program;
+
+    // inserts a "#define" line per entry right after the #version directive
+    static std::string addDefines(const std::string &source, const std::vector<std::string> &defines) {
+        if (defines.empty())
+            return source;
+        std::string header;
+        for (const auto &define : defines)
+            header += "#define " + define + "\n";
+        size_t line = source.find("#version");
+        if (line == std::string::npos)
+            return header + source;
+        line = source.find('\n', line);
+        if (line == std::string::npos)
+            return source + "\n" + header;
+        return source.substr(0, line + 1) + header + source.substr(line + 1);
+    }
 public:
-    Shader(std::string vertexShaderPath, std::string fragmentShaderPath, std::string geometryShaderPath = "") {
+    // feedbackVaryings are captured interleaved by transform feedback, they have to be set before linking
+    Shader(std::string vertexShaderPath, std::string fragmentShaderPath, std::string geometryShaderPath = "",
+           const std::vector<std::string> &defines = {}, const std::vector<std::string> &feedbackVaryings = {}) {
+        PROFILE_SCOPE("shader compile");
         //appendShaderFolderIfNotPresent(vertexShaderPath);
         //appendShaderFolderIfNotPresent(fragmentShaderPath);
         // build and compile our shader program
@@ -20,6 +43,7 @@ public:
         // vertex shader
         std::string vsString = readFileContents(vertexShaderPath);
         ASSERT(!vsString.empty(), "Vertex shader source is empty!");
+        vsString = addDefines(vsString, defines);
         const char* vertexShaderSource = vsString.c_str();
         int vertexShader = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -36,6 +60,7 @@ public:
         // fragment shader
         std::string fsString = readFileContents(fragmentShaderPath);
         ASSERT(!fsString.empty(), "Fragment shader empty!");
+        fsString = addDefines(fsString, defines);
         const char* fragmentShaderSource = fsString.c_str();
         int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
@@ -52,6 +77,7 @@ public:
         if(!geometryShaderPath.empty()) {
             std::string gsString = readFileContents(geometryShaderPath);
             ASSERT(!gsString.empty(), "Geometry shader empty!");
+            gsString = addDefines(gsString, defines);
             const char *geometryShaderSource = gsString.c_str();
 
             glShaderSource(geometryShader, 1, &geometryShaderSource, NULL);
@@ -64,11 +90,18 @@ public:
             }
         }
         // link shaders
+        GL_MEMORY_OWNER("shader");
         int shaderProgram = glCreateProgram();
         glAttachShader(shaderProgram, vertexShader);
         glAttachShader(shaderProgram, fragmentShader);
         if(!geometryShaderPath.empty())
             glAttachShader(shaderProgram, geometryShader);
+        if (!feedbackVaryings.empty()) {
+            std::vector<const char *> varyings;
+            for (const auto &varying : feedbackVaryings)
+                varyings.push_back(varying.c_str());
+            glTransformFeedbackVaryings(shaderProgram, (GLsizei)varyings.size(), varyings.data(), GL_INTERLEAVED_ATTRIBS);
+        }
         glLinkProgram(shaderProgram);
         // check for linking errors
         glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
@@ -80,77 +113,104 @@ public:
         glDeleteShader(fragmentShader);
         if(!geometryShaderPath.empty())
             glDeleteShader(geometryShader);
-        m_Id = shaderProgram;
+        GLDebug::label(GL_PROGRAM, shaderProgram, fragmentShaderPath.c_str());
+        m_Program.reset(shaderProgram);
     }
 
     // activate the shader
     // ------------------------------------------------------------------------
     void use()
     {
-        glUseProgram(m_Id);
+        glUseProgram(m_Program.get());
     }
     // utility uniform functions
+    // names are C strings, a literal turned into a std::string would allocate on every call
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const
+    void setBool(const char *name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        glUniform1i(glGetUniformLocation(m_Program.get(), name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const
+    void setInt(const char *name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1i(glGetUniformLocation(m_Program.get(), name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const
+    void setFloat(const char *name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        glUniform1f(glGetUniformLocation(m_Program.get(), name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const
+    void setVec2(const char *name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform2fv(glGetUniformLocation(m_Program.get(), name), 1, &value[0]);
     }
-    void setVec2(const std::string &name, float x, float y) const
+    void setVec2(const char *name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(glGetUniformLocation(m_Program.get(), name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const
+    void setVec3(const char *name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform3fv(glGetUniformLocation(m_Program.get(), name), 1, &value[0]);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const
+    void setVec3(const char *name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(glGetUniformLocation(m_Program.get(), name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const
+    void setVec4(const char *name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        glUniform4fv(glGetUniformLocation(m_Program.get(), name), 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z, float w)
+    void setVec4(const char *name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4f(glGetUniformLocation(m_Program.get(), name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const
+    void setMat2(const char *name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(glGetUniformLocation(m_Program.get(), name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const
+    void setMat3(const char *name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(glGetUniformLocation(m_Program.get(), name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const
+    void setMat4(const char *name, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(m_Program.get(), name), 1, GL_FALSE, &mat[0][0]);
+    }
+    // uniform arrays, from element 0 of name on
+    void setMat4Array(const char *name, const glm::mat4 *mats, int count) const
+    {
+        glUniformMatrix4fv(glGetUniformLocation(m_Program.get(), name), count, GL_FALSE, &mats[0][0][0]);
+    }
+    void setIntArray(const char *name, const int *values, int count) const
+    {
+        glUniform1iv(glGetUniformLocation(m_Program.get(), name), count, values);
+    }
+    void setFloatArray(const char *name, const float *values, int count) const
+    {
+        glUniform1fv(glGetUniformLocation(m_Program.get(), name), count, values);
+    }
+    void setVec4Array(const char *name, const glm::vec4 *values, int count) const
+    {
+        glUniform4fv(glGetUniformLocation(m_Program.get(), name), count, &values[0][0]);
+    }
+
+    // GLSL 330 has no layout(binding), blocks are attached to binding points from here
+    void bindUniformBlock(const char *name, unsigned int binding) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        unsigned int index = glGetUniformBlockIndex(m_Program.get(), name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(m_Program.get(), index, binding);
     }
 
+    // the program goes with the shader too, this only lets it go earlier
     void deleteProgram() {
-        glDeleteProgram(m_Id);
-        m_Id = 0;
+        m_Program.reset();
     }
 
 
@@ -0,0 +1,255 @@
+//
+// Cascaded shadow maps for the directional light. Each cascade is a square
+// centred on the camera, so turning the camera never moves it; the centre only
+// jumps in steps of a quarter of the cascade radius, and the map covers that
+// much extra on every side.
+//
+// Static casters are drawn into a cached depth layer per cascade, redrawn only
+// when the light turns, the static geometry changes or the cascade jumps. Each
+// frame the cached layer is blitted into the sampled layer and the dynamic
+// casters are drawn on top of it, so only they cost draw calls every frame.
+//
+
+#ifndef PROJECT_BASE_SHADOWCASCADES_H
+#define PROJECT_BASE_SHADOWCASCADES_H
+
+#include <algorithm>
+#include <cmath>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/Shader.h>
+
+class ShadowCascades {
+public:
+    static const unsigned int CASCADES = 3;
+
+    // std140 mirror of the Shadows block in lights.fs and model.fs
+    struct Block {
+        glm::mat4 lightSpace[CASCADES];
+        // xyz: cascade radius around the camera, w: on/off
+        glm::vec4 radius;
+        // xyz: world size of a shadow texel per cascade, w: texel size in texture coordinates
+        glm::vec4 texel;
+        glm::vec4 viewPosition;
+    };
+    static_assert(sizeof(Block) == 240, "Block must match the std140 layout of the Shadows block");
+
+private:
+    static_assert(CASCADES == 3, "Block packs one cascade per vec4 component");
+
+    // the cascade centre moves in steps of this fraction of its radius
+    static constexpr float STEP = 0.25f;
+    // light-space depth kept on both sides of the centre, covers the whole scene
+    static constexpr float DEPTH_RANGE = 100.0f;
+
+    Shader m_Depth;
+    GLTexture m_Static;
+    GLTexture m_Final;
+    GLFramebuffer m_StaticFbo;
+    GLFramebuffer m_FinalFbo;
+    int m_Size;
+    bool m_Enabled = true;
+
+    float m_Radius[CASCADES];
+    glm::vec3 m_Direction = glm::vec3(0.0f);
+    glm::mat4 m_LightView = glm::mat4(1.0f);
+    glm::vec3 m_Center[CASCADES];
+    glm::mat4 m_LightSpace[CASCADES];
+    bool m_StaticDirty[CASCADES];
+    unsigned long m_StaticRenders = 0;
+
+    static GLTexture createArray(int size, bool compare) {
+        GLTexture texture = GLTexture::create();
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture.get());
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, CASCADES, 0, GL_DEPTH_COMPONENT,
+                     GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+        // outside the map counts as lit
+        float border[] = {1.0f, 1.0f, 1.0f, 1.0f};
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        // hardware 2x2 PCF on the sampled array
+        if (compare) {
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return texture;
+    }
+
+    float extent(unsigned int cascade) const {
+        return m_Radius[cascade] * (1.0f + STEP);
+    }
+
+    float texelWorld(unsigned int cascade) const {
+        return 2.0f * extent(cascade) / (float)m_Size;
+    }
+
+    template <typename Draw>
+    void drawLayer(unsigned int fbo, unsigned int texture, unsigned int cascade, bool clear, Draw &draw) {
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, cascade);
+        if (clear)
+            glClear(GL_DEPTH_BUFFER_BIT);
+        m_Depth.setMat4("lightSpace", m_LightSpace[cascade]);
+        draw(m_Depth);
+    }
+
+public:
+    // cascade radii follow the practical split scheme between near and far
+    ShadowCascades(int size, float near, float far, float lambda = 0.75f)
+            : m_Depth("resources/shaders/shadow_depth.vs", "resources/shaders/shadow_depth.fs"), m_Size(size) {
+        for (unsigned int i = 0; i < CASCADES; i++) {
+            float t = (float)(i + 1) / CASCADES;
+            float logarithmic = near * std::pow(far / near, t);
+            float linear = near + (far - near) * t;
+            m_Radius[i] = lambda * logarithmic + (1.0f - lambda) * linear;
+            m_Center[i] = glm::vec3(0.0f);
+            m_LightSpace[i] = glm::mat4(1.0f);
+            m_StaticDirty[i] = true;
+        }
+
+        GL_MEMORY_OWNER("sun shadows");
+        m_Static = createArray(size, false);
+        m_Final = createArray(size, true);
+        GLDebug::label(GL_TEXTURE, m_Static.get(), "sun shadows, static casters");
+        GLDebug::label(GL_TEXTURE, m_Final.get(), "sun shadows");
+        m_StaticFbo = GLFramebuffer::create();
+        m_FinalFbo = GLFramebuffer::create();
+        for (unsigned int fbo : {m_StaticFbo.get(), m_FinalFbo.get()}) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ShadowCascades(const ShadowCascades &) = delete;
+    ShadowCascades &operator=(const ShadowCascades &) = delete;
+
+    ~ShadowCascades() {
+        m_Depth.deleteProgram();
+    }
+
+    void setEnabled(bool enabled) {
+        m_Enabled = enabled;
+    }
+
+    bool enabled() const {
+        return m_Enabled;
+    }
+
+    // direction the light travels in, as in DirLight; turning it invalidates every cached layer
+    void setLight(const glm::vec3 &direction) {
+        glm::vec3 d = glm::normalize(direction);
+        if (glm::dot(d, m_Direction) > 0.99999f)
+            return;
+        m_Direction = d;
+        glm::vec3 up = std::abs(d.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        m_LightView = glm::lookAt(glm::vec3(0.0f), d, up);
+        invalidateStatic();
+    }
+
+    // call when a static caster moves, appears or disappears
+    void invalidateStatic() {
+        for (bool &dirty : m_StaticDirty)
+            dirty = true;
+    }
+
+    // places the cascades around the camera; a cascade that jumps needs its static layer redrawn
+    void update(const glm::vec3 &viewPosition) {
+        glm::vec3 light = glm::vec3(m_LightView * glm::vec4(viewPosition, 1.0f));
+        for (unsigned int i = 0; i < CASCADES; i++) {
+            // whole texels per step, so the map never shifts by a fraction of a texel
+            float texel = texelWorld(i);
+            float step = std::max(1.0f, std::round(m_Radius[i] * STEP / texel)) * texel;
+            glm::vec3 center = glm::floor(light / step + glm::vec3(0.5f)) * step;
+            if (center != m_Center[i]) {
+                m_Center[i] = center;
+                m_StaticDirty[i] = true;
+            }
+            float e = extent(i);
+            // light view space looks down -z, ortho takes distances in front of the eye
+            glm::mat4 projection = glm::ortho(center.x - e, center.x + e, center.y - e, center.y + e,
+                                              -center.z - DEPTH_RANGE, -center.z + DEPTH_RANGE);
+            m_LightSpace[i] = projection * m_LightView;
+        }
+    }
+
+    // drawStatic and drawDynamic get the depth shader and set its "model" uniform per caster
+    template <typename DrawStatic, typename DrawDynamic>
+    void render(DrawStatic drawStatic, DrawDynamic drawDynamic) {
+        if (!m_Enabled)
+            return;
+        m_Depth.use();
+        glViewport(0, 0, m_Size, m_Size);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        // casters are not all closed meshes, so both sides are drawn and the bias comes from the offset
+        glDisable(GL_CULL_FACE);
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        for (unsigned int i = 0; i < CASCADES; i++) {
+            if (m_StaticDirty[i]) {
+                GLDebugGroup group("static casters");
+                drawLayer(m_StaticFbo.get(), m_Static.get(), i, true, drawStatic);
+                m_StaticDirty[i] = false;
+                m_StaticRenders++;
+            }
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, m_StaticFbo.get());
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Static.get(), 0, i);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FinalFbo.get());
+            glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_Final.get(), 0, i);
+            glBlitFramebuffer(0, 0, m_Size, m_Size, 0, 0, m_Size, m_Size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+            GLDebugGroup group("dynamic casters");
+            drawLayer(m_FinalFbo.get(), m_Final.get(), i, false, drawDynamic);
+        }
+
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glEnable(GL_CULL_FACE);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    Block block(const glm::vec3 &viewPosition) const {
+        Block b;
+        for (unsigned int i = 0; i < CASCADES; i++)
+            b.lightSpace[i] = m_LightSpace[i];
+        b.radius = glm::vec4(m_Radius[0], m_Radius[1], m_Radius[2], m_Enabled ? 1.0f : 0.0f);
+        b.texel = glm::vec4(texelWorld(0), texelWorld(1), texelWorld(2), 1.0f / (float)m_Size);
+        b.viewPosition = glm::vec4(viewPosition, 1.0f);
+        return b;
+    }
+
+    void bind(GLenum unit) const {
+        glActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_Final.get());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    unsigned int texture() const {
+        return m_Final.get();
+    }
+
+    int size() const {
+        return m_Size;
+    }
+
+    float radius(unsigned int cascade) const {
+        return m_Radius[cascade];
+    }
+
+    // how many times a static layer has been redrawn
+    unsigned long staticRenders() const {
+        return m_StaticRenders;
+    }
+};
+
+#endif //PROJECT_BASE_SHADOWCASCADES_H
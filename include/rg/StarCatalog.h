@@ -0,0 +1,286 @@
+//
+// The background sky drawn from a star catalog instead of the skybox faces.
+// A CSV catalog (HYG columns: ra in hours, dec in degrees, mag, ci) is
+// converted once into a compact binary file, brightest star first, twelve
+// bytes per star. Loading maps that file and hands it to the GPU as it is.
+//
+// Every star is a point sprite sized in pixels, so stars stay sharp at any
+// zoom. Since the stars are sorted, dropping the faint ones is drawing a
+// prefix of the buffer: the limiting magnitude rises as the field of view
+// narrows, like a telescope, and a budget caps the count.
+//
+
+#ifndef PROJECT_BASE_STARCATALOG_H
+#define PROJECT_BASE_STARCATALOG_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/Profiler.h>
+#include <rg/Shader.h>
+
+class StarCatalog {
+public:
+    // one star as stored in the file and in the vertex buffer
+    struct Star {
+        // thousandths of a magnitude
+        int16_t magnitude;
+        // B-V colour index in thousandths
+        int16_t colorIndex;
+        // unit vector, y towards the celestial north pole
+        int16_t direction[3];
+        int16_t unused;
+    };
+    static_assert(sizeof(Star) == 12, "Star is the on-disk layout");
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t count;
+    };
+
+    static const uint32_t VERSION = 1;
+    // brighter than anything but the sun, which catalogs like HYG list as well
+    static constexpr float BRIGHTEST = -2.0f;
+    static constexpr float FAINTEST = 22.0f;
+    static constexpr float BUCKET = 0.05f;
+    static const int BUCKETS = (int)((FAINTEST - BRIGHTEST) / BUCKET);
+    // what the eye sees at the widest zoom
+    static constexpr float NAKED_EYE = 6.5f;
+    static constexpr float WIDE_FOV = 45.0f;
+
+    Shader m_Shader;
+    GLVertexArray m_Vao;
+    GLBuffer m_Vbo;
+    uint32_t m_Count = 0;
+    unsigned int m_Budget;
+    // stars brighter than the upper edge of each magnitude bucket
+    std::vector<uint32_t> m_Brighter;
+    float m_Limit = NAKED_EYE;
+    uint32_t m_Drawn = 0;
+
+    static int16_t pack(float value, float scale) {
+        return (int16_t)std::max(-32767.0f, std::min(32767.0f, std::round(value * scale)));
+    }
+
+    static std::vector<std::string> splitCsv(const std::string &line) {
+        std::vector<std::string> fields;
+        std::string field;
+        std::istringstream in(line);
+        while (std::getline(in, field, ',')) {
+            field.erase(std::remove(field.begin(), field.end(), '"'), field.end());
+            fields.push_back(field);
+        }
+        return fields;
+    }
+
+    static bool newer(const std::string &path, const std::string &than) {
+        struct stat a, b;
+        if (stat(path.c_str(), &a) != 0)
+            return false;
+        return stat(than.c_str(), &b) != 0 || a.st_mtime > b.st_mtime;
+    }
+
+    static bool convert(const std::string &csvPath, const std::string &binaryPath) {
+        PROFILE_SCOPE("star catalog convert");
+        std::ifstream in(csvPath);
+        std::string line;
+        if (!std::getline(in, line))
+            return false;
+        std::vector<std::string> columns = splitCsv(line);
+        int ra = -1, dec = -1, mag = -1, ci = -1;
+        for (int i = 0; i < (int)columns.size(); i++) {
+            std::string name = columns[i];
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "ra") ra = i;
+            else if (name == "dec") dec = i;
+            else if (name == "mag") mag = i;
+            else if (name == "ci") ci = i;
+        }
+        if (ra < 0 || dec < 0 || mag < 0)
+            return false;
+        int needed = std::max(ra, std::max(dec, mag));
+
+        std::vector<Star> stars;
+        while (std::getline(in, line)) {
+            std::vector<std::string> fields = splitCsv(line);
+            if ((int)fields.size() <= needed || fields[mag].empty())
+                continue;
+            float magnitude = (float)std::atof(fields[mag].c_str());
+            if (magnitude < BRIGHTEST || magnitude >= FAINTEST)
+                continue;
+            float alpha = (float)std::atof(fields[ra].c_str()) * glm::radians(15.0f);
+            float delta = glm::radians((float)std::atof(fields[dec].c_str()));
+            glm::vec3 direction(std::cos(delta) * std::cos(alpha), std::sin(delta), -std::cos(delta) * std::sin(alpha));
+            float colorIndex = ci >= 0 && ci < (int)fields.size() ? (float)std::atof(fields[ci].c_str()) : 0.6f;
+            Star star;
+            star.magnitude = pack(magnitude, 1000.0f);
+            star.colorIndex = pack(colorIndex, 1000.0f);
+            for (int c = 0; c < 3; c++)
+                star.direction[c] = pack(direction[c], 32767.0f);
+            star.unused = 0;
+            stars.push_back(star);
+        }
+        std::sort(stars.begin(), stars.end(), [](const Star &a, const Star &b) { return a.magnitude < b.magnitude; });
+
+        size_t slash = binaryPath.find_last_of('/');
+        if (slash != std::string::npos)
+            mkdir(binaryPath.substr(0, slash).c_str(), 0755);
+        std::string temporary = binaryPath + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+            return false;
+        Header header;
+        std::memcpy(header.magic, "SPACESTR", 8);
+        header.version = VERSION;
+        header.count = (uint32_t)stars.size();
+        out.write((const char *)&header, sizeof(header));
+        out.write((const char *)stars.data(), stars.size() * sizeof(Star));
+        out.close();
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return std::rename(temporary.c_str(), binaryPath.c_str()) == 0;
+    }
+
+    // the file is mapped, not read, and goes straight from the page cache into the vertex buffer
+    bool load(const std::string &binaryPath) {
+        PROFILE_SCOPE("star catalog load");
+        int fd = open(binaryPath.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(Header)) {
+            close(fd);
+            return false;
+        }
+        size_t size = (size_t)info.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+
+        const Header *header = (const Header *)mapped;
+        bool valid = std::memcmp(header->magic, "SPACESTR", 8) == 0 && header->version == VERSION &&
+                     sizeof(Header) + (size_t)header->count * sizeof(Star) <= size;
+        if (valid) {
+            m_Count = header->count;
+            const Star *stars = (const Star *)((const char *)mapped + sizeof(Header));
+            m_Brighter.assign(BUCKETS, 0);
+            for (uint32_t i = 0; i < m_Count; i++) {
+                int bucket = (int)((stars[i].magnitude * 0.001f - BRIGHTEST) / BUCKET);
+                m_Brighter[std::max(0, std::min(BUCKETS - 1, bucket))]++;
+            }
+            for (int b = 1; b < BUCKETS; b++)
+                m_Brighter[b] += m_Brighter[b - 1];
+
+            glBindVertexArray(m_Vao.get());
+            glBindBuffer(GL_ARRAY_BUFFER, m_Vbo.get());
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)m_Count * sizeof(Star), stars, GL_STATIC_DRAW);
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        munmap(mapped, size);
+        return valid && m_Count > 0;
+    }
+
+public:
+    // csvPath is converted into binaryPath when the binary is missing or older; either may be absent
+    StarCatalog(const std::string &csvPath, const std::string &binaryPath, unsigned int budget)
+            : m_Shader("resources/shaders/stars.vs", "resources/shaders/stars.fs"), m_Budget(budget) {
+        GL_MEMORY_OWNER("stars");
+        m_Vao = GLVertexArray::create();
+        m_Vbo = GLBuffer::create();
+        glBindVertexArray(m_Vao.get());
+        glBindBuffer(GL_ARRAY_BUFFER, m_Vbo.get());
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(Star), (void *)offsetof(Star, magnitude));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_SHORT, GL_TRUE, sizeof(Star), (void *)offsetof(Star, direction));
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        GLDebug::label(GL_BUFFER, m_Vbo.get(), "stars");
+
+        if (newer(csvPath, binaryPath) && !convert(csvPath, binaryPath))
+            std::cout << "Failed to convert star catalog " << csvPath << std::endl;
+        if (!load(binaryPath))
+            m_Count = 0;
+    }
+
+    StarCatalog(const StarCatalog &) = delete;
+    StarCatalog &operator=(const StarCatalog &) = delete;
+
+    ~StarCatalog() {
+        m_Shader.deleteProgram();
+    }
+
+    bool loaded() const {
+        return m_Count > 0;
+    }
+
+    uint32_t count() const {
+        return m_Count;
+    }
+
+    // stars and limiting magnitude of the last draw
+    uint32_t drawn() const {
+        return m_Drawn;
+    }
+
+    float limit() const {
+        return m_Limit;
+    }
+
+    // the faintest magnitude shown at a vertical field of view, and how many stars are that bright
+    uint32_t visible(float fovDegrees, float &limit) const {
+        limit = NAKED_EYE + 5.0f * std::log10(WIDE_FOV / std::max(fovDegrees, 0.1f));
+        int bucket = std::max(0, std::min(BUCKETS - 1, (int)((limit - BRIGHTEST) / BUCKET)));
+        while (bucket > 0 && m_Brighter[bucket] > m_Budget)
+            bucket--;
+        limit = std::min(limit, BRIGHTEST + (bucket + 1) * BUCKET);
+        return std::min(m_Brighter[bucket], m_Budget);
+    }
+
+    // in the sky pass, with the depth test at LEQUAL; rotation is the view matrix without translation
+    void draw(const glm::mat4 &rotation, const glm::mat4 &projection) {
+        if (!loaded())
+            return;
+        float fov = glm::degrees(2.0f * std::atan(1.0f / projection[1][1]));
+        m_Drawn = visible(fov, m_Limit);
+
+        m_Shader.use();
+        m_Shader.setMat4("viewProjection", projection * rotation);
+        m_Shader.setFloat("limit", m_Limit);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glDepthMask(GL_FALSE);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glBindVertexArray(m_Vao.get());
+        glDrawArrays(GL_POINTS, 0, (GLsizei)m_Drawn);
+        glBindVertexArray(0);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+};
+
+#endif //PROJECT_BASE_STARCATALOG_H
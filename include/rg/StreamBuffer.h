@@ -0,0 +1,178 @@
+//
+// Ring buffer for data rewritten every frame (uniform blocks, instance data,
+// streamed vertices). The buffer is split into one region per frame in flight
+// and a fence guards every region, so the CPU never writes memory the GPU may
+// still be reading and the driver never has to synchronise or orphan.
+//
+// With ARB_buffer_storage (core in 4.4) the buffer is mapped once, persistently
+// and coherently, and written in place. On plain 3.3 writes go to a CPU copy of
+// the region and are uploaded with one glBufferSubData per frame.
+//
+
+#ifndef PROJECT_BASE_STREAMBUFFER_H
+#define PROJECT_BASE_STREAMBUFFER_H
+
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+#include <rg/Error.h>
+#include <rg/GLHandle.h>
+#include <rg/GLMemory.h>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+class StreamBuffer {
+public:
+    struct Allocation {
+        void *data;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+private:
+    typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+    static BufferStorageProc &bufferStorage() {
+        static BufferStorageProc proc = nullptr;
+        return proc;
+    }
+
+    static const unsigned int REGIONS = 3;
+
+    GLenum m_Target;
+    GLBuffer m_Buffer;
+    GLsizeiptr m_RegionSize;
+    GLint m_Alignment = 1;
+    unsigned int m_Region = 0;
+    GLsizeiptr m_Head = 0;
+    GLsync m_Fences[REGIONS] = {};
+
+    char *m_Mapped = nullptr;
+    std::vector<char> m_Staging;
+
+    unsigned long m_Waits = 0;
+
+    char *regionBase() {
+        return m_Mapped != nullptr ? m_Mapped + m_Region * m_RegionSize : m_Staging.data();
+    }
+
+public:
+    // looks up glBufferStorage once a context is current; glad is only generated for 3.3
+    static void loadExtensions(GLADloadproc load) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, i);
+            if (name != nullptr && std::strcmp(name, "GL_ARB_buffer_storage") == 0) {
+                bufferStorage() = (BufferStorageProc)load("glBufferStorage");
+                return;
+            }
+        }
+    }
+
+    // regionSize bytes can be allocated per frame
+    StreamBuffer(GLenum target, GLsizeiptr regionSize) : m_Target(target) {
+        if (target == GL_UNIFORM_BUFFER)
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_Alignment);
+        m_RegionSize = (regionSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+        GLsizeiptr total = m_RegionSize * REGIONS;
+
+        GL_MEMORY_OWNER("stream buffer");
+        m_Buffer = GLBuffer::create();
+        glBindBuffer(m_Target, m_Buffer.get());
+        if (bufferStorage() != nullptr) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage()(m_Target, total, nullptr, flags);
+            GLMemory::setBufferSize(m_Buffer.get(), (size_t)total);
+            m_Mapped = (char *)glMapBufferRange(m_Target, 0, total, flags);
+        }
+        if (m_Mapped == nullptr) {
+            glBufferData(m_Target, total, nullptr, GL_STREAM_DRAW);
+            m_Staging.resize(m_RegionSize);
+        }
+        glBindBuffer(m_Target, 0);
+    }
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+    ~StreamBuffer() {
+        for (auto &fence : m_Fences)
+            if (fence != nullptr)
+                glDeleteSync(fence);
+        if (m_Mapped != nullptr) {
+            glBindBuffer(m_Target, m_Buffer.get());
+            glUnmapBuffer(m_Target);
+            glBindBuffer(m_Target, 0);
+        }
+    }
+
+    // moves to the next region, waiting only if the GPU is still using it from REGIONS frames ago
+    void beginFrame() {
+        m_Region = (m_Region + 1) % REGIONS;
+        m_Head = 0;
+        GLsync &fence = m_Fences[m_Region];
+        if (fence == nullptr)
+            return;
+        GLenum status = glClientWaitSync(fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            m_Waits++;
+            while (status == GL_TIMEOUT_EXPIRED)
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    Allocation allocate(GLsizeiptr size) {
+        GLsizeiptr start = (m_Head + m_Alignment - 1) / m_Alignment * m_Alignment;
+        ASSERT(start + size <= m_RegionSize, "Stream buffer region overflow!");
+        m_Head = start + size;
+        return Allocation{regionBase() + start, m_Region * m_RegionSize + start, size};
+    }
+
+    template <typename T>
+    Allocation upload(const T &value) {
+        Allocation allocation = allocate(sizeof(T));
+        std::memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    // makes this frame's writes visible to the GPU; call before the draws that read them
+    void flush() {
+        if (m_Mapped != nullptr || m_Head == 0)
+            return;
+        glBindBuffer(m_Target, m_Buffer.get());
+        glBufferSubData(m_Target, m_Region * m_RegionSize, m_Head, m_Staging.data());
+        glBindBuffer(m_Target, 0);
+    }
+
+    // call once the frame's draws are submitted
+    void endFrame() {
+        m_Fences[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    void bindRange(unsigned int index, const Allocation &allocation) const {
+        glBindBufferRange(m_Target, index, m_Buffer.get(), allocation.offset, allocation.size);
+    }
+
+    unsigned int id() const {
+        return m_Buffer.get();
+    }
+
+    bool persistent() const {
+        return m_Mapped != nullptr;
+    }
+
+    // frames that had to wait for the GPU to release a region
+    unsigned long waits() const {
+        return m_Waits;
+    }
+};
+
+#endif //PROJECT_BASE_STREAMBUFFER_H
@@ -7,17 +7,25 @@
 #include <glad/glad.h>
 #include <stb_image.h>
 #include <rg/Error.h>
+#include <rg/GLHandle.h>
+#include <rg/GLMemory.h>
+#include <rg/Profiler.h>
 
 class Texture2D {
-    unsigned int m_Id;
+    GLTexture m_Texture;
 public:
     Texture2D(std::string pathToImg, bool gammaCorrection) {
-        unsigned int tex;
-        glGenTextures(1, &tex);
+        GL_MEMORY_OWNER("texture");
+        m_Texture = GLTexture::create();
+        unsigned int tex = m_Texture.get();
 
         int width, height, nChannel;
         stbi_set_flip_vertically_on_load(true);
-        unsigned char* data = stbi_load(pathToImg.c_str(), &width, &height, &nChannel, 0);
+        unsigned char* data;
+        {
+            PROFILE_SCOPE("texture decode");
+            data = stbi_load(pathToImg.c_str(), &width, &height, &nChannel, 0);
+        }
 
         if(data) {
             GLenum internalFormat = 0;
@@ -47,6 +55,7 @@ public:
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
 
+            PROFILE_SCOPE("texture upload");
             glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
             glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -56,11 +65,10 @@ public:
         }
 
         stbi_image_free(data);
-        m_Id = tex;
     }
     void active(GLenum e) {
         glActiveTexture(e);
-        glBindTexture(GL_TEXTURE_2D, m_Id);
+        glBindTexture(GL_TEXTURE_2D, m_Texture.get());
     }
 
 };
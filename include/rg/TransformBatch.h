@@ -0,0 +1,175 @@
+//
+// Per-object transform batch: model, MVP and normal matrices for every object
+// drawn in a frame, computed together with SIMD kernels on the CPU.
+//
+
+#ifndef PROJECT_BASE_TRANSFORMBATCH_H
+#define PROJECT_BASE_TRANSFORMBATCH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <rg/Shader.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace rg {
+namespace simd {
+// one lane per object; the kernels below are written once against these helpers
+#if defined(__AVX__)
+    typedef __m256 lane;
+    const unsigned int width = 8;
+    inline lane load(const float *p) { return _mm256_loadu_ps(p); }
+    inline void store(float *p, lane v) { _mm256_storeu_ps(p, v); }
+    inline lane set1(float x) { return _mm256_set1_ps(x); }
+    inline lane add(lane a, lane b) { return _mm256_add_ps(a, b); }
+    inline lane sub(lane a, lane b) { return _mm256_sub_ps(a, b); }
+    inline lane mul(lane a, lane b) { return _mm256_mul_ps(a, b); }
+    inline lane div(lane a, lane b) { return _mm256_div_ps(a, b); }
+#elif defined(__SSE__)
+    typedef __m128 lane;
+    const unsigned int width = 4;
+    inline lane load(const float *p) { return _mm_loadu_ps(p); }
+    inline void store(float *p, lane v) { _mm_storeu_ps(p, v); }
+    inline lane set1(float x) { return _mm_set1_ps(x); }
+    inline lane add(lane a, lane b) { return _mm_add_ps(a, b); }
+    inline lane sub(lane a, lane b) { return _mm_sub_ps(a, b); }
+    inline lane mul(lane a, lane b) { return _mm_mul_ps(a, b); }
+    inline lane div(lane a, lane b) { return _mm_div_ps(a, b); }
+#else
+    typedef float lane;
+    const unsigned int width = 1;
+    inline lane load(const float *p) { return *p; }
+    inline void store(float *p, lane v) { *p = v; }
+    inline lane set1(float x) { return x; }
+    inline lane add(lane a, lane b) { return a + b; }
+    inline lane sub(lane a, lane b) { return a - b; }
+    inline lane mul(lane a, lane b) { return a * b; }
+    inline lane div(lane a, lane b) { return a / b; }
+#endif
+}
+}
+
+class TransformBatch {
+    // structure of arrays, element [c * 4 + r] of every object's matrix is stored contiguously
+    std::vector<float> m_Model[16];
+    std::vector<float> m_Mvp[16];
+    std::vector<float> m_Normal[9];
+    unsigned int m_Count = 0;
+
+public:
+    // queues an object for this frame and returns its slot
+    unsigned int add(const glm::mat4 &model) {
+        for (unsigned int c = 0; c < 4; c++)
+            for (unsigned int r = 0; r < 4; r++)
+                m_Model[c * 4 + r].push_back(model[c][r]);
+        return m_Count++;
+    }
+
+    // forgets last frame's objects, keeps the storage
+    void clear() {
+        for (auto &v : m_Model)
+            v.clear();
+        m_Count = 0;
+    }
+
+    unsigned int size() const {
+        return m_Count;
+    }
+
+    // computes MVP = viewProjection * model and the inverse-transpose of mat3(model) for all objects
+    void compute(const glm::mat4 &viewProjection) {
+        if (m_Count == 0)
+            return;
+
+        // pad the tail with identity matrices so every lane of the last block is valid
+        const unsigned int width = rg::simd::width;
+        unsigned int padded = (m_Count + width - 1) / width * width;
+        for (unsigned int e = 0; e < 16; e++)
+            m_Model[e].resize(padded, (e % 5 == 0) ? 1.0f : 0.0f);
+        for (auto &v : m_Mvp)
+            v.resize(padded);
+        for (auto &v : m_Normal)
+            v.resize(padded);
+
+        rg::simd::lane vp[16];
+        for (unsigned int c = 0; c < 4; c++)
+            for (unsigned int r = 0; r < 4; r++)
+                vp[c * 4 + r] = rg::simd::set1(viewProjection[c][r]);
+
+        for (unsigned int i = 0; i < padded; i += width) {
+            rg::simd::lane m[16];
+            for (unsigned int e = 0; e < 16; e++)
+                m[e] = rg::simd::load(&m_Model[e][i]);
+
+            // mvp[c][r] = sum_k vp[k][r] * m[c][k]
+            for (unsigned int c = 0; c < 4; c++) {
+                for (unsigned int r = 0; r < 4; r++) {
+                    rg::simd::lane acc = rg::simd::mul(vp[r], m[c * 4]);
+                    acc = rg::simd::add(acc, rg::simd::mul(vp[4 + r], m[c * 4 + 1]));
+                    acc = rg::simd::add(acc, rg::simd::mul(vp[8 + r], m[c * 4 + 2]));
+                    acc = rg::simd::add(acc, rg::simd::mul(vp[12 + r], m[c * 4 + 3]));
+                    rg::simd::store(&m_Mvp[c * 4 + r][i], acc);
+                }
+            }
+
+            // with a, b, c the columns of mat3(model): inverse-transpose = [b x c, c x a, a x b] / det
+            const rg::simd::lane ax = m[0], ay = m[1], az = m[2];
+            const rg::simd::lane bx = m[4], by = m[5], bz = m[6];
+            const rg::simd::lane cx = m[8], cy = m[9], cz = m[10];
+
+            rg::simd::lane n[9];
+            n[0] = rg::simd::sub(rg::simd::mul(by, cz), rg::simd::mul(bz, cy));
+            n[1] = rg::simd::sub(rg::simd::mul(bz, cx), rg::simd::mul(bx, cz));
+            n[2] = rg::simd::sub(rg::simd::mul(bx, cy), rg::simd::mul(by, cx));
+            n[3] = rg::simd::sub(rg::simd::mul(cy, az), rg::simd::mul(cz, ay));
+            n[4] = rg::simd::sub(rg::simd::mul(cz, ax), rg::simd::mul(cx, az));
+            n[5] = rg::simd::sub(rg::simd::mul(cx, ay), rg::simd::mul(cy, ax));
+            n[6] = rg::simd::sub(rg::simd::mul(ay, bz), rg::simd::mul(az, by));
+            n[7] = rg::simd::sub(rg::simd::mul(az, bx), rg::simd::mul(ax, bz));
+            n[8] = rg::simd::sub(rg::simd::mul(ax, by), rg::simd::mul(ay, bx));
+
+            rg::simd::lane det = rg::simd::add(rg::simd::add(rg::simd::mul(ax, n[0]), rg::simd::mul(ay, n[1])), rg::simd::mul(az, n[2]));
+            rg::simd::lane invDet = rg::simd::div(rg::simd::set1(1.0f), det);
+            for (unsigned int e = 0; e < 9; e++)
+                rg::simd::store(&m_Normal[e][i], rg::simd::mul(n[e], invDet));
+        }
+    }
+
+    glm::mat4 model(unsigned int i) const {
+        return gather(m_Model, i);
+    }
+
+    glm::mat4 mvp(unsigned int i) const {
+        return gather(m_Mvp, i);
+    }
+
+    glm::mat3 normalMatrix(unsigned int i) const {
+        glm::mat3 result;
+        for (unsigned int c = 0; c < 3; c++)
+            for (unsigned int r = 0; r < 3; r++)
+                result[c][r] = m_Normal[c * 3 + r][i];
+        return result;
+    }
+
+    // uploads the object's matrices to the "model", "mvp" and "normalMatrix" uniforms
+    void apply(const Shader &shader, unsigned int i) const {
+        shader.setMat4("model", model(i));
+        shader.setMat4("mvp", mvp(i));
+        shader.setMat3("normalMatrix", normalMatrix(i));
+    }
+
+private:
+    static glm::mat4 gather(const std::vector<float> (&soa)[16], unsigned int i) {
+        glm::mat4 result;
+        for (unsigned int c = 0; c < 4; c++)
+            for (unsigned int r = 0; r < 4; r++)
+                result[c][r] = soa[c * 4 + r][i];
+        return result;
+    }
+};
+
+#endif //PROJECT_BASE_TRANSFORMBATCH_H
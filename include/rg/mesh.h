@@ -9,6 +9,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <rg/Shader.h>
+#include <rg/GLHandle.h>
+#include <rg/Profiler.h>
 
 #include <string>
 #include <vector>
@@ -33,6 +35,7 @@ struct Vertex {
     float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// the name belongs to the Model that loaded it, meshes share it
 struct Texture {
     unsigned int id;
     string type;
@@ -45,51 +48,38 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    GLVertexArray VAO;
 
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : vertices(std::move(vertices)), indices(std::move(indices)), textures(std::move(textures))
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
-
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
+        nameSamplers();
     }
 
+    // the buffers are owned, a mesh can be moved but not copied
+    Mesh(Mesh &&) = default;
+    Mesh &operator=(Mesh &&) = default;
+    Mesh(const Mesh &) = delete;
+    Mesh &operator=(const Mesh &) = delete;
+
     // render the mesh
     void Draw(Shader &shader)
     {
         // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
         for(unsigned int i = 0; i < textures.size(); i++)
         {
             glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
             // now set the sampler to the correct texture unit
-            name.append(number);
-            shader.setInt(name, i);
+            shader.setInt(samplerNames[i].c_str(), i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
 
         // draw mesh
-        glBindVertexArray(VAO);
+        glBindVertexArray(VAO.get());
         glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
         glBindVertexArray(0);
 
@@ -97,27 +87,62 @@ public:
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // positions only, for depth passes that need no textures
+    void DrawGeometry(GLsizei instances = 1)
+    {
+        glBindVertexArray(VAO.get());
+        glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0, instances);
+        glBindVertexArray(0);
+    }
+
 private:
     // render data
-    unsigned int VBO, EBO;
+    GLBuffer VBO, EBO;
+    // sampler uniform of each texture (texture_diffuseN, ...), built once instead of on every draw
+    vector<string> samplerNames;
+
+    void nameSamplers()
+    {
+        unsigned int diffuseNr  = 1;
+        unsigned int specularNr = 1;
+        unsigned int normalNr   = 1;
+        unsigned int heightNr   = 1;
+        for(const Texture &texture : textures)
+        {
+            // retrieve texture number (the N in diffuse_textureN)
+            string number;
+            const string &name = texture.type;
+            if(name == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if(name == "texture_specular")
+                number = std::to_string(specularNr++); // transfer unsigned int to string
+            else if(name == "texture_normal")
+                number = std::to_string(normalNr++); // transfer unsigned int to string
+            else if(name == "texture_height")
+                number = std::to_string(heightNr++); // transfer unsigned int to string
+            samplerNames.push_back(name + number);
+        }
+    }
 
     // initializes all the buffer objects/arrays
     void setupMesh()
     {
+        PROFILE_SCOPE("mesh upload");
+        GL_MEMORY_OWNER("mesh");
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
-        glGenBuffers(1, &VBO);
-        glGenBuffers(1, &EBO);
+        VAO = GLVertexArray::create();
+        VBO = GLBuffer::create();
+        EBO = GLBuffer::create();
 
-        glBindVertexArray(VAO);
+        glBindVertexArray(VAO.get());
         // load data into vertex buffers
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO.get());
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
         glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO.get());
         glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
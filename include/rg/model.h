@@ -14,7 +14,9 @@
 
 #include <rg/mesh.h>
 #include <rg/Shader.h>
+#include <rg/Profiler.h>
 
+#include <algorithm>
 #include <string>
 #include <fstream>
 #include <sstream>
@@ -23,13 +25,14 @@
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+GLTexture TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 class Model
 {
 public:
     // model data
     vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<GLTexture> texture_names;	// owns the ids in textures_loaded, the meshes only refer to them
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
@@ -40,6 +43,11 @@ public:
         loadModel(path);
     }
 
+    Model(Model &&) = default;
+    Model &operator=(Model &&) = default;
+    Model(const Model &) = delete;
+    Model &operator=(const Model &) = delete;
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -47,13 +55,34 @@ public:
             meshes[i].Draw(shader);
     }
 
+    void DrawGeometry(GLsizei instances = 1)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawGeometry(instances);
+    }
+
+    // radius of a sphere around the model origin that holds every vertex
+    float BoundingRadius() const
+    {
+        float radius = 0.0f;
+        for(const Mesh &mesh : meshes)
+            for(const Vertex &vertex : mesh.vertices)
+                radius = std::max(radius, glm::length(vertex.Position));
+        return radius;
+    }
+
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
+        PROFILE_SCOPE("model load");
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene;
+        {
+            PROFILE_SCOPE("model import");
+            scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
@@ -63,6 +92,8 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
+        // one slot per scene mesh, so the vector does not grow while meshes are added
+        meshes.reserve(scene->mNumMeshes);
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
     }
@@ -167,7 +198,7 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures));
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -193,11 +224,13 @@ private:
             if(!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                GLTexture name = TextureFromFile(str.C_Str(), this->directory);
+                texture.id = name.get();
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
+                textures_loaded.push_back(texture);
+                texture_names.push_back(std::move(name));  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
             }
         }
         return textures;
@@ -205,16 +238,20 @@ private:
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+GLTexture TextureFromFile(const char *path, const string &directory, bool gamma)
 {
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    GL_MEMORY_OWNER("model texture");
+    GLTexture textureID = GLTexture::create();
 
     int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    unsigned char *data;
+    {
+        PROFILE_SCOPE("texture decode");
+        data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+    }
     if(data) {
         GLenum internalFormat = 0;
         GLenum dataFormat = 0;
@@ -231,7 +268,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
             dataFormat = GL_RGBA;
         }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
+        PROFILE_SCOPE("texture upload");
+        glBindTexture(GL_TEXTURE_2D, textureID.get());
         glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, dataFormat, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
 
@@ -4,12 +4,10 @@ layout (location = 1) in vec2 aTexCoords;
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
 
 void main()
 {
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = mvp * vec4(aPos, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+
+// 13-tap downsample (Jimenez, "Next Generation Post Processing in Call of Duty")
+void main()
+{
+    vec2 texel = 1.0 / textureSize(srcTexture, 0);
+    float x = texel.x;
+    float y = texel.y;
+
+    vec3 a = texture(srcTexture, vec2(TexCoords.x - 2.0 * x, TexCoords.y + 2.0 * y)).rgb;
+    vec3 b = texture(srcTexture, vec2(TexCoords.x,           TexCoords.y + 2.0 * y)).rgb;
+    vec3 c = texture(srcTexture, vec2(TexCoords.x + 2.0 * x, TexCoords.y + 2.0 * y)).rgb;
+
+    vec3 d = texture(srcTexture, vec2(TexCoords.x - 2.0 * x, TexCoords.y)).rgb;
+    vec3 e = texture(srcTexture, vec2(TexCoords.x,           TexCoords.y)).rgb;
+    vec3 f = texture(srcTexture, vec2(TexCoords.x + 2.0 * x, TexCoords.y)).rgb;
+
+    vec3 g = texture(srcTexture, vec2(TexCoords.x - 2.0 * x, TexCoords.y - 2.0 * y)).rgb;
+    vec3 h = texture(srcTexture, vec2(TexCoords.x,           TexCoords.y - 2.0 * y)).rgb;
+    vec3 i = texture(srcTexture, vec2(TexCoords.x + 2.0 * x, TexCoords.y - 2.0 * y)).rgb;
+
+    vec3 j = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y + y)).rgb;
+    vec3 k = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y + y)).rgb;
+    vec3 l = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y - y)).rgb;
+    vec3 m = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y - y)).rgb;
+
+    vec3 result = e * 0.125;
+    result += (a + c + g + i) * 0.03125;
+    result += (b + d + f + h) * 0.0625;
+    result += (j + k + l + m) * 0.125;
+    FragColor = vec4(max(result, 0.0001), 1.0);
+}
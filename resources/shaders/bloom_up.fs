@@ -0,0 +1,32 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D srcTexture;
+uniform float filterRadius;
+
+// 3x3 tent upsample, added on top of the destination mip by additive blending
+void main()
+{
+    float x = filterRadius;
+    float y = filterRadius * float(textureSize(srcTexture, 0).x) / float(textureSize(srcTexture, 0).y);
+
+    vec3 a = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y + y)).rgb;
+    vec3 b = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y + y)).rgb;
+    vec3 c = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y + y)).rgb;
+
+    vec3 d = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y)).rgb;
+    vec3 e = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y)).rgb;
+    vec3 f = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y)).rgb;
+
+    vec3 g = texture(srcTexture, vec2(TexCoords.x - x, TexCoords.y - y)).rgb;
+    vec3 h = texture(srcTexture, vec2(TexCoords.x,     TexCoords.y - y)).rgb;
+    vec3 i = texture(srcTexture, vec2(TexCoords.x + x, TexCoords.y - y)).rgb;
+
+    vec3 result = e * 4.0;
+    result += (b + d + f + h) * 2.0;
+    result += (a + c + g + i);
+    result *= 1.0 / 16.0;
+    FragColor = vec4(result, 1.0);
+}
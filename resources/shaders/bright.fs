@@ -0,0 +1,22 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D hdrBuffer;
+uniform float threshold;
+uniform float knee;
+
+// bloom threshold with a quadratic soft knee, run at reduced resolution;
+// bilinear filtering averages the 2x2 source texels under every output texel
+void main()
+{
+    vec3 color = texture(hdrBuffer, TexCoords).rgb;
+    float brightness = dot(color, vec3(0.2126, 0.7152, 0.0722));
+
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 0.00001);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 0.00001);
+
+    FragColor = vec4(color * contribution, 1.0);
+}
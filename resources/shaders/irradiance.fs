@@ -0,0 +1,30 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 WorldPos;
+
+uniform samplerCube environmentMap;
+
+const float PI = 3.14159265359;
+
+// cosine weighted average of the environment over the hemisphere around the normal
+void main()
+{
+    vec3 normal = normalize(WorldPos);
+    vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 right = normalize(cross(up, normal));
+    up = cross(normal, right);
+
+    vec3 irradiance = vec3(0.0);
+    float sampleDelta = 0.025;
+    float samples = 0.0;
+    for (float phi = 0.0; phi < 2.0 * PI; phi += sampleDelta) {
+        for (float theta = 0.0; theta < 0.5 * PI; theta += sampleDelta) {
+            vec3 tangentSample = vec3(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta));
+            vec3 sampleVec = tangentSample.x * right + tangentSample.y * up + tangentSample.z * normal;
+            irradiance += texture(environmentMap, sampleVec).rgb * cos(theta) * sin(theta);
+            samples++;
+        }
+    }
+    FragColor = vec4(PI * irradiance / samples, 1.0);
+}
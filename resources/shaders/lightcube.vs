@@ -9,17 +9,16 @@ out vec3 Normal;
 out vec2 TexCoords;
 
 
-uniform mat4 projection;
-uniform mat4 view;
 uniform mat4 model;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
     TexCoords = aTexCoords;
 
-    mat3 normalMatrix = transpose(inverse(mat3(model)));
-    Normal = normalize(normalMatrix * aNormal);
+    Normal = normalMatrix * aNormal;
 
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 }
\ No newline at end of file
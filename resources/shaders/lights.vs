@@ -9,15 +9,15 @@ out vec3 FragPos;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 
 void main()
 {
-    Normal = normalize(mat3(transpose(inverse(model))) * aNormal);
+    Normal = normalMatrix * aNormal;
     FragPos = vec3(model * vec4(aPos, 1.0));
     TexCoords = aTex;
-    gl_Position = projection * view * vec4(FragPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 
 }
\ No newline at end of file
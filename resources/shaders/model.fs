@@ -1,6 +1,5 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -49,12 +48,38 @@ uniform sampler2D texture_specular1;
 
 uniform vec3 lightColor;
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight[NR_SPOT_LIGHTS];
+// filled from a StreamBuffer once per frame, std140 mirrors LightsBlock in main.cpp
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+    SpotLight spotLight[NR_SPOT_LIGHTS];
+};
+
+#define NR_CASCADES 3
+
+// sun shadow cascades, std140 mirrors ShadowCascades::Block
+layout (std140) uniform Shadows {
+    mat4 cascadeLightSpace[NR_CASCADES];
+    vec4 cascadeRadius;
+    vec4 cascadeTexel;
+    vec4 shadowViewPosition;
+};
+uniform sampler2DArrayShadow shadowMap;
+// distance to the orbiting light over farPlane, 0 with the point shadows off
+uniform samplerCubeShadow pointShadowMap;
+uniform float pointShadowFar;
+// image based ambient from the skybox, see EnvironmentLighting; iblStrength 0 keeps the flat ambient
+uniform samplerCube irradianceMap;
+uniform samplerCube prefilterMap;
+uniform sampler2D brdfLUT;
+uniform float iblStrength;
+#define PREFILTER_MAX_LOD 4.0
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
+float CalcDirShadow(vec3 normal, vec3 fragPos);
+vec3 CalcAmbient(vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor, float roughness);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+float CalcPointShadow(vec3 normal, vec3 fragPos, vec3 lightPos);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 
 void main()
@@ -66,12 +91,7 @@ void main()
     for (int i = 0; i < NR_SPOT_LIGHTS; i++){
         result += CalcSpotLight(spotLight[i], normal, FragPos, viewDir);
     }
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-        if(brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
-        FragColor = vec4(result, 1.0);
+    FragColor = vec4(result, 1.0);
 }
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
@@ -81,11 +101,46 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir) {
     vec3 halfwayDir = normalize(lightDir + viewDir);
     float spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
 
-    vec3 ambient = light.ambient * vec3(texture(texture_diffuse1, TexCoords));
+    // roughness of the fixed exponent 32
+    vec3 ambient = light.ambient * CalcAmbient(normal, viewDir, vec3(texture(texture_diffuse1, TexCoords)),
+                                               texture(texture_specular1, TexCoords).xxx, 0.24);
     vec3 diffuse = light.diffuse * diff * vec3(texture(texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * vec3(texture(texture_specular1, TexCoords).xxx);
 
-    return (ambient + diffuse + specular);
+    float shadow = CalcDirShadow(normal, FragPos);
+
+    return (ambient + shadow * (diffuse + specular));
+}
+
+vec3 CalcAmbient(vec3 normal, vec3 viewDir, vec3 albedo, vec3 specularColor, float roughness) {
+    if (iblStrength == 0.0)
+        return albedo;
+    float NdotV = max(dot(normal, viewDir), 0.0);
+    vec3 R = reflect(-viewDir, normal);
+    vec2 brdf = texture(brdfLUT, vec2(NdotV, roughness)).rg;
+    vec3 diffuse = texture(irradianceMap, normal).rgb * albedo;
+    vec3 specular = textureLod(prefilterMap, R, roughness * PREFILTER_MAX_LOD).rgb * specularColor * (0.04 * brdf.x + brdf.y);
+    return iblStrength * (diffuse + specular);
+}
+
+float CalcDirShadow(vec3 normal, vec3 fragPos) {
+    if (cascadeRadius.w == 0.0)
+        return 1.0;
+    float distance = length(fragPos - shadowViewPosition.xyz);
+    int cascade = 0;
+    while (cascade < NR_CASCADES && distance >= cascadeRadius[cascade])
+        cascade++;
+    if (cascade == NR_CASCADES)
+        return 1.0;
+
+    // a texel and a half along the normal keeps surfaces from shadowing themselves
+    vec3 position = fragPos + normal * cascadeTexel[cascade] * 1.5;
+    vec3 coords = (cascadeLightSpace[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * cascadeTexel.w, float(cascade), coords.z));
+    return lit / 9.0;
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
@@ -102,7 +157,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir) {
     vec3 diffuse = light.diffuse * diff * attenuation * vec3(texture(texture_diffuse1, TexCoords));
     vec3 specular = light.specular * spec * attenuation * vec3(texture(texture_specular1, TexCoords).xxx);
 
-    return(ambient + diffuse + specular);
+    float shadow = CalcPointShadow(normal, fragPos, light.position);
+
+    return(ambient + shadow * (diffuse + specular));
+}
+
+float CalcPointShadow(vec3 normal, vec3 fragPos, vec3 lightPos) {
+    if (pointShadowFar == 0.0)
+        return 1.0;
+    vec3 toFrag = fragPos + normal * 0.03 - lightPos;
+    return texture(pointShadowMap, vec4(toFrag, length(toFrag) / pointShadowFar - 0.002));
 }
 
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir){
@@ -0,0 +1,14 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Color;
+
+void main()
+{
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    float r2 = dot(p, p);
+    if (r2 > 1.0)
+        discard;
+    // added to the HDR target, so bright particles reach the bloom
+    FragColor = vec4(Color * (1.0 - r2), 1.0);
+}
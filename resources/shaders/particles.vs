@@ -0,0 +1,21 @@
+#version 330 core
+layout (location = 0) in vec4 aPosition;
+layout (location = 1) in vec4 aVelocity;
+layout (location = 2) in float aKind;
+
+out vec3 Color;
+
+uniform mat4 viewProjection;
+uniform float pointScale;
+// rgb: colour, a: sprite size in world units
+uniform vec4 look[3];
+
+void main()
+{
+    vec4 kindLook = look[int(aKind)];
+    gl_Position = viewProjection * vec4(aPosition.xyz, 1.0);
+    gl_PointSize = clamp(kindLook.a * pointScale / max(gl_Position.w, 0.01), 1.0, 64.0);
+    // quick fade in, then out over the rest of the lifetime
+    float t = aPosition.w / aVelocity.w;
+    Color = kindLook.rgb * smoothstep(0.0, 0.1, t) * (1.0 - t);
+}
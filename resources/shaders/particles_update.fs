@@ -0,0 +1,6 @@
+#version 330 core
+// the update runs with GL_RASTERIZER_DISCARD, this never executes
+
+void main()
+{
+}
@@ -0,0 +1,23 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec4 vPosition[];
+in vec4 vVelocity[];
+in float vKind[];
+
+out vec4 outPosition;
+out vec4 outVelocity;
+out float outKind;
+
+// dead particles are not emitted, so the survivors end up packed in the output buffer
+void main()
+{
+    if (vPosition[0].w >= vVelocity[0].w)
+        return;
+    outPosition = vPosition[0];
+    outVelocity = vVelocity[0];
+    outKind = vKind[0];
+    EmitVertex();
+    EndPrimitive();
+}
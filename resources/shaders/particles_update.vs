@@ -0,0 +1,69 @@
+#version 330 core
+layout (location = 0) in vec4 aPosition;
+layout (location = 1) in vec4 aVelocity;
+layout (location = 2) in float aKind;
+
+out vec4 vPosition;
+out vec4 vVelocity;
+out float vKind;
+
+uniform float deltaTime;
+uniform float drag[3];
+
+// while emitting nothing is read, every vertex spawns a particle of the emitter below
+uniform bool emitting;
+uniform int seed;
+uniform int emitterShape;
+uniform vec3 emitterPosition;
+uniform vec3 emitterExtent;
+uniform vec3 emitterVelocity;
+uniform float emitterSpeed;
+uniform vec2 emitterLife;
+uniform float emitterKind;
+
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float random(inout uint state)
+{
+    state = hash(state);
+    return float(state) * (1.0 / 4294967296.0);
+}
+
+vec3 randomDirection(inout uint state)
+{
+    float z = random(state) * 2.0 - 1.0;
+    float angle = random(state) * 6.28318530718;
+    float r = sqrt(max(0.0, 1.0 - z * z));
+    return vec3(r * cos(angle), r * sin(angle), z);
+}
+
+void main()
+{
+    if (emitting) {
+        uint state = hash(uint(gl_VertexID) ^ hash(uint(seed)));
+        vec3 direction = randomDirection(state);
+        vec3 position;
+        if (emitterShape == 0)
+            position = emitterPosition + direction * emitterExtent.x;
+        else
+            position = emitterPosition + (vec3(random(state), random(state), random(state)) * 2.0 - 1.0) * emitterExtent;
+        vec3 velocity = emitterVelocity + direction * emitterSpeed * random(state);
+        vPosition = vec4(position, 0.0);
+        vVelocity = vec4(velocity, mix(emitterLife.x, emitterLife.y, random(state)));
+        vKind = emitterKind;
+        return;
+    }
+
+    vec3 velocity = aVelocity.xyz * exp(-drag[int(aKind)] * deltaTime);
+    vPosition = vec4(aPosition.xyz + velocity * deltaTime, aPosition.w + deltaTime);
+    vVelocity = vec4(velocity, aVelocity.w);
+    vKind = aKind;
+}
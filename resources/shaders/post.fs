@@ -0,0 +1,97 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// every enabled post effect runs in this one pass; PostStack compiles one
+// permutation per combination of STAGE_* defines
+
+uniform sampler2D hdrBuffer;
+uniform sampler2D bloomBlur;
+uniform bool bloom;
+uniform float bloomStrength;
+uniform float exposure;
+
+uniform float saturation;
+uniform float contrast;
+uniform vec3 tint;
+uniform float vignetteStrength;
+
+const vec3 LUMA = vec3(0.2126, 0.7152, 0.0722);
+
+// HDR + bloom, exposure tonemapping and colour grading, in linear space
+vec3 resolve(vec2 uv)
+{
+    vec3 hdrColor = texture(hdrBuffer, uv).rgb;
+    if(bloom)
+        hdrColor += texture(bloomBlur, uv).rgb * bloomStrength;
+    vec3 color = vec3(1.0) - exp(-hdrColor * exposure);
+#ifdef STAGE_GRADING
+    color *= tint;
+    color = mix(vec3(dot(color, LUMA)), color, saturation);
+    color = clamp((color - 0.5) * contrast + 0.5, 0.0, 1.0);
+#endif
+    return color;
+}
+
+#ifdef STAGE_FXAA
+// FXAA on the graded image; the neighbourhood is resolved on the fly so no
+// intermediate LDR target is needed
+vec3 fxaa(vec2 uv)
+{
+    const float REDUCE_MIN = 1.0 / 128.0;
+    const float REDUCE_MUL = 1.0 / 8.0;
+    const float SPAN_MAX = 8.0;
+    vec2 texel = 1.0 / textureSize(hdrBuffer, 0);
+
+    vec3 rgbNW = resolve(uv + vec2(-1.0, -1.0) * texel);
+    vec3 rgbNE = resolve(uv + vec2( 1.0, -1.0) * texel);
+    vec3 rgbSW = resolve(uv + vec2(-1.0,  1.0) * texel);
+    vec3 rgbSE = resolve(uv + vec2( 1.0,  1.0) * texel);
+    vec3 rgbM  = resolve(uv);
+
+    float lumaNW = dot(rgbNW, LUMA);
+    float lumaNE = dot(rgbNE, LUMA);
+    float lumaSW = dot(rgbSW, LUMA);
+    float lumaSE = dot(rgbSE, LUMA);
+    float lumaM  = dot(rgbM, LUMA);
+    float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    vec2 dir;
+    dir.x = -((lumaNW + lumaNE) - (lumaSW + lumaSE));
+    dir.y =  ((lumaNW + lumaSW) - (lumaNE + lumaSE));
+    float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * (0.25 * REDUCE_MUL), REDUCE_MIN);
+    float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);
+    dir = clamp(dir * rcpDirMin, vec2(-SPAN_MAX), vec2(SPAN_MAX)) * texel;
+
+    vec3 rgbA = 0.5 * (resolve(uv + dir * (1.0 / 3.0 - 0.5)) + resolve(uv + dir * (2.0 / 3.0 - 0.5)));
+    vec3 rgbB = rgbA * 0.5 + 0.25 * (resolve(uv - dir * 0.5) + resolve(uv + dir * 0.5));
+    float lumaB = dot(rgbB, LUMA);
+    if(lumaB < lumaMin || lumaB > lumaMax)
+        return rgbA;
+    return rgbB;
+}
+#endif
+
+void main()
+{
+    const float gamma = 2.2;
+#ifdef STAGE_FXAA
+    vec3 result = fxaa(TexCoords);
+#else
+    vec3 result = resolve(TexCoords);
+#endif
+#ifdef STAGE_VIGNETTE
+    vec2 centered = TexCoords - 0.5;
+    result *= mix(1.0, smoothstep(0.8, 0.25, length(centered)), vignetteStrength);
+#endif
+    result = pow(result, vec3(1.0 / gamma));
+#ifdef STAGE_DITHER
+    // triangular noise of +-1 LSB hides banding in the 8-bit backbuffer
+    float noise = fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    float noise2 = fract(sin(dot(gl_FragCoord.xy + 0.37, vec2(12.9898, 78.233))) * 43758.5453);
+    result += (noise + noise2 - 1.0) / 255.0;
+#endif
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,79 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 WorldPos;
+
+uniform samplerCube environmentMap;
+uniform float roughness;
+// face size of the environment map, for picking the source mip per sample
+uniform float resolution;
+
+const float PI = 3.14159265359;
+const uint SAMPLE_COUNT = 1024u;
+
+float DistributionGGX(float NdotH, float roughness)
+{
+    float a = roughness * roughness;
+    float a2 = a * a;
+    float denom = NdotH * NdotH * (a2 - 1.0) + 1.0;
+    return a2 / (PI * denom * denom);
+}
+
+float RadicalInverse_VdC(uint bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return float(bits) * 2.3283064365386963e-10;
+}
+
+vec2 Hammersley(uint i, uint n)
+{
+    return vec2(float(i) / float(n), RadicalInverse_VdC(i));
+}
+
+vec3 ImportanceSampleGGX(vec2 xi, vec3 normal, float roughness)
+{
+    float a = roughness * roughness;
+    float phi = 2.0 * PI * xi.x;
+    float cosTheta = sqrt((1.0 - xi.y) / (1.0 + (a * a - 1.0) * xi.y));
+    float sinTheta = sqrt(1.0 - cosTheta * cosTheta);
+    vec3 h = vec3(cos(phi) * sinTheta, sin(phi) * sinTheta, cosTheta);
+
+    vec3 up = abs(normal.z) < 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, normal));
+    vec3 bitangent = cross(normal, tangent);
+    return normalize(tangent * h.x + bitangent * h.y + normal * h.z);
+}
+
+// GGX lobe convolution under the split sum approximation, N = V = R
+void main()
+{
+    vec3 N = normalize(WorldPos);
+    vec3 R = N;
+    vec3 V = R;
+
+    vec3 color = vec3(0.0);
+    float totalWeight = 0.0;
+    for (uint i = 0u; i < SAMPLE_COUNT; i++) {
+        vec2 xi = Hammersley(i, SAMPLE_COUNT);
+        vec3 H = ImportanceSampleGGX(xi, N, roughness);
+        vec3 L = normalize(2.0 * dot(V, H) * H - V);
+        float NdotL = max(dot(N, L), 0.0);
+        if (NdotL > 0.0) {
+            // samples covering a large solid angle read a smaller mip, which keeps bright texels from sparkling
+            float NdotH = max(dot(N, H), 0.0);
+            float HdotV = max(dot(H, V), 0.0);
+            float pdf = DistributionGGX(NdotH, roughness) * NdotH / (4.0 * HdotV) + 0.0001;
+            float saTexel = 4.0 * PI / (6.0 * resolution * resolution);
+            float saSample = 1.0 / (float(SAMPLE_COUNT) * pdf + 0.0001);
+            float mipLevel = roughness == 0.0 ? 0.0 : 0.5 * log2(saSample / saTexel);
+
+            color += textureLod(environmentMap, L, mipLevel).rgb * NdotL;
+            totalWeight += NdotL;
+        }
+    }
+    FragColor = vec4(color / totalWeight, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPos;
+uniform float farPlane;
+
+// linear distance to the light, so every face stores the same scale
+void main()
+{
+    gl_FragDepth = length(FragPos - lightPos) / farPlane;
+}
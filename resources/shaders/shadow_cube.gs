@@ -0,0 +1,38 @@
+#version 330 core
+#ifdef INVOCATIONS
+#extension GL_ARB_gpu_shader5 : require
+layout (triangles, invocations = 6) in;
+layout (triangle_strip, max_vertices = 3) out;
+#else
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+#endif
+
+uniform mat4 faceMatrices[6];
+// only the faces the caster reaches, listed by PointShadows
+uniform int faces[6];
+uniform int faceCount;
+
+out vec3 FragPos;
+
+void EmitFace(int face)
+{
+    for (int i = 0; i < 3; i++) {
+        FragPos = gl_in[i].gl_Position.xyz;
+        gl_Layer = face;
+        gl_Position = faceMatrices[face] * gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
+}
+
+void main()
+{
+#ifdef INVOCATIONS
+    if (gl_InvocationID < faceCount)
+        EmitFace(faces[gl_InvocationID]);
+#else
+    for (int i = 0; i < faceCount; i++)
+        EmitFace(faces[i]);
+#endif
+}
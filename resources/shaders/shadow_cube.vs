@@ -0,0 +1,30 @@
+#version 330 core
+#ifdef VERTEX_LAYER
+#extension GL_ARB_shader_viewport_layer_array : enable
+#extension GL_AMD_vertex_shader_layer : enable
+#endif
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+#ifdef VERTEX_LAYER
+// one instance per touched face, the vertex shader picks the layer itself
+uniform mat4 faceMatrices[6];
+uniform int faces[6];
+
+out vec3 FragPos;
+#endif
+
+void main()
+{
+    vec4 world = model * vec4(aPos, 1.0);
+#ifdef VERTEX_LAYER
+    int face = faces[gl_InstanceID];
+    FragPos = world.xyz;
+    gl_Layer = face;
+    gl_Position = faceMatrices[face] * world;
+#else
+    // world space, the geometry shader projects into each face
+    gl_Position = world;
+#endif
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// depth only, the colour attachments are disabled
+void main()
+{
+}
@@ -0,0 +1,10 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 Color;
+
+void main()
+{
+    vec2 p = gl_PointCoord * 2.0 - 1.0;
+    FragColor = vec4(Color * max(0.0, 1.0 - dot(p, p)), 1.0);
+}
@@ -0,0 +1,26 @@
+#version 330 core
+// x: magnitude, y: B-V colour index, both in thousandths
+layout (location = 0) in vec2 aMagnitude;
+layout (location = 1) in vec3 aDirection;
+
+out vec3 Color;
+
+uniform mat4 viewProjection;
+// faintest magnitude drawn
+uniform float limit;
+
+void main()
+{
+    vec4 pos = viewProjection * vec4(aDirection, 1.0);
+    gl_Position = pos.xyww;
+
+    // flux relative to a star at the limit, spread over a sprite that grows with it
+    float flux = pow(10.0, 0.4 * (limit - aMagnitude.x * 0.001));
+    float size = clamp(sqrt(flux), 1.0, 6.0);
+    gl_PointSize = size;
+
+    float bv = aMagnitude.y * 0.001;
+    vec3 tint = bv < 0.6 ? mix(vec3(0.65, 0.75, 1.0), vec3(1.0), clamp(bv + 0.4, 0.0, 1.0))
+                         : mix(vec3(1.0), vec3(1.0, 0.6, 0.35), clamp((bv - 0.6) / 1.4, 0.0, 1.0));
+    Color = tint * 0.1 * flux / (size * size);
+}
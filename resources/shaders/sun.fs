@@ -1,6 +1,5 @@
 #version 330 core
 layout (location = 0) out vec4 FragColor;
-layout (location = 1) out vec4 BrightColor;
 
 in vec3 FragPos;
 in vec3 Normal;
@@ -48,9 +47,12 @@ uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
 uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight[NR_SPOT_LIGHTS];
+// filled from a StreamBuffer once per frame, std140 mirrors LightsBlock in main.cpp
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+    SpotLight spotLight[NR_SPOT_LIGHTS];
+};
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -65,11 +67,6 @@ void main()
     for (int i = 0; i < NR_SPOT_LIGHTS; i++){
         result += CalcSpotLight(spotLight[i], normal, FragPos, viewDir);
     }
-    float brightness = dot(result, vec3(0.2126, 0.7152, 0.0722));
-        if(brightness > 1.0)
-            BrightColor = vec4(result, 1.0);
-        else
-            BrightColor = vec4(0.0, 0.0, 0.0, 1.0);
     FragColor = vec4(result, 1.0);
 }
 
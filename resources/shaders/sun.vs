@@ -9,13 +9,13 @@ out vec3 Normal;
 
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform mat4 mvp;
+uniform mat3 normalMatrix;
 
 void main()
 {
     FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = normalize(mat3(transpose(inverse(model))) * aNormal);
+    Normal = normalMatrix * aNormal;
     TexCoords = aTexCoords;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = mvp * vec4(aPos, 1.0);
 }
\ No newline at end of file
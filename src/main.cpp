@@ -1,16 +1,77 @@
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <thread>
+#include <chrono>
 #include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <rg/Shader.h>
 #include <learnopengl/filesystem.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <rg/Texture2D.h>
 #include <rg/Cubemap2D.h>
 #include <rg/Camera.h>
 #include <rg/model.h>
+#include <rg/TransformBatch.h>
+#include <rg/GpuTimer.h>
+#include <rg/Bloom.h>
+#include <rg/DynamicResolution.h>
+#include <rg/FrameGraph.h>
+#include <rg/PostStack.h>
+#include <rg/RenderQueue.h>
+#include <rg/FrameQueue.h>
+#include <rg/FixedTimestep.h>
+#include <rg/StreamBuffer.h>
+#include <rg/PerfOverlay.h>
+#include <rg/Profiler.h>
+#include <rg/GpuProfiler.h>
+#include <rg/FrameStats.h>
+#include <rg/CameraPath.h>
+#include <rg/FrameCapture.h>
+#include <rg/GLDebug.h>
+#include <rg/GLHandle.h>
+#include <rg/ShadowCascades.h>
+#include <rg/PointShadows.h>
+#include <rg/EnvironmentLighting.h>
+#include <rg/ParticleSystem.h>
+#include <rg/StarCatalog.h>
+#include <rg/AllocationTracker.h>
+
+
+// C++ allocations of the program go through here, so --alloc-check can count them;
+// malloc calls made inside C libraries (GLFW, assimp, stb, the GL driver) bypass it
+void *operator new(size_t size) {
+    AllocationTracker::record(size);
+    if (void *memory = std::malloc(size > 0 ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
 
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+    std::free(memory);
+}
 
 void processInput(GLFWwindow *window);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -18,13 +79,88 @@ void update(GLFWwindow *window);
 void key_callback(GLFWwindow * window, int key, int scancode, int action, int mods);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+void reportBloomTiers();
+void reportResolution();
+GLFWwindow *createWindow(int width, int height, bool headless);
+void scriptedCamera(float progress);
+bool keyDown(GLFWwindow *window, int key);
+void replayPath(GLFWwindow *window);
 
 
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+
+// --benchmark renders a fixed number of frames along a scripted camera path and
+// writes frame-time statistics; --headless does the same without a display
+struct BenchmarkConfig {
+    bool enabled = false;
+    bool headless = false;
+    unsigned int warmup = 60;
+    unsigned int frames = 600;
+    int width = SCR_WIDTH;
+    int height = SCR_HEIGHT;
+    std::string output = "space_bench.json";
+};
+BenchmarkConfig benchmark;
+void writeBenchmarkReport(const FrameStats &stats);
+
+// --record <file> saves the camera flight and key presses, --replay <file> plays them
+// back one simulation tick per frame
+enum PathMode { PATH_OFF, PATH_RECORD, PATH_REPLAY };
+PathMode pathMode = PATH_OFF;
+std::string pathFile;
+CameraPath cameraPath;
+// time of the latest simulation tick
+double simulationTime = 0.0;
+// key presses of this frame; they act on the ticks the frame runs, so they are stamped with the time after them
+std::vector<CameraPath::KeyEvent> recordedKeys;
+
+// F3 or --capture <file> records the frames to a Y4M video
+std::string capturePath = "space_capture.y4m";
+bool captureFromStart = false;
+// frame rate written into the video header, 0 picks it from how the frames are paced
+int captureFps = 0;
+// frames timed before a recording without a fixed rate starts
+const unsigned long CAPTURE_RATE_FRAMES = 30;
+void reportCapture(const FrameCapture &capture);
+
+// --gl-debug <high|medium|low|notification> sets the least severe KHR_debug message shown,
+// --gl-debug-sync reports from inside the failing call
+GLDebug::Severity glDebugSeverity = GLDebug::MEDIUM;
+bool glDebugSynchronous = false;
+// --gl-memory tracks every GL object with its size and owner; F8 lists them, leaks are listed at exit
+bool glMemoryTracking = false;
+
+// --cube-shadows <vertex|invocations|loop> forces a way of routing the point light shadow faces,
+// by default the best one the driver supports is picked
+PointShadows::Path cubeShadowPath = PointShadows::AUTO;
+
+// --particles <count> sets how many particles the GPU buffers hold, 0 turns them off
+unsigned int particleCapacity = 1u << 20;
+
+// --stars <csv> draws the sky from a star catalog, converted once into cache/stars.bin;
+// without either file the skybox stays
+std::string starCatalogPath = "resources/stars/catalog.csv";
+int framebufferWidth = SCR_WIDTH;
+int framebufferHeight = SCR_HEIGHT;
+// the scene is rendered at a fraction of the framebuffer size chosen to fit this budget
+DynamicResolution resolution(1000.0f / 60.0f);
 bool bloom = true;
 bool bloomKeyPressed = false;
 float exposure = 1.0f;
+
+struct BloomTier {
+    const char *name;
+    unsigned int levels;
+};
+const BloomTier bloomTiers[] = {{"low", 3}, {"medium", 5}, {"high", 7}};
+const unsigned int BLOOM_TIER_COUNT = sizeof(bloomTiers) / sizeof(bloomTiers[0]);
+unsigned int bloomTier = 1;
+GpuTimer *bloomTimers = nullptr;
+// the bloom threshold is extracted at 1/BRIGHT_PASS_DIVISOR of the scene resolution
+const int BRIGHT_PASS_DIVISOR = 2;
+const float BLOOM_THRESHOLD = 1.0f;
+const float BLOOM_KNEE = 0.25f;
 glm::vec3 lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
 
 Camera camera;
@@ -70,34 +206,455 @@ struct SpotLight {
     float quadratic;
 };
 
+// std140 image of the "Lights" uniform block in lights.fs, sun.fs and model.fs
+struct LightsBlock {
+    struct {
+        glm::vec3 direction; float pad0;
+        glm::vec3 ambient; float pad1;
+        glm::vec3 diffuse; float pad2;
+        glm::vec3 specular; float pad3;
+    } dirLight;
+    struct {
+        glm::vec3 position; float pad0;
+        glm::vec3 ambient; float pad1;
+        glm::vec3 diffuse; float pad2;
+        glm::vec3 specular;
+        float constant;
+        float linear;
+        float quadratic;
+        float pad3[2];
+    } pointLight;
+    struct {
+        glm::vec3 position; float pad0;
+        glm::vec3 direction;
+        float cutOff;
+        float outerCutOff; float pad1[3];
+        glm::vec3 ambient; float pad2;
+        glm::vec3 diffuse; float pad3;
+        glm::vec3 specular;
+        float constant;
+        float linear;
+        float quadratic;
+        float pad4[2];
+    } spotLight[4];
+};
+static_assert(sizeof(LightsBlock) == 592, "LightsBlock must match the std140 layout of the Lights block");
+const unsigned int LIGHTS_BINDING = 0;
+const unsigned int SHADOWS_BINDING = 1;
+// texture unit of the sun shadow cascades, above the ones materials use
+const unsigned int SHADOW_MAP_UNIT = 8;
+const int SHADOW_MAP_SIZE = 2048;
+const unsigned int POINT_SHADOW_UNIT = 9;
+const int POINT_SHADOW_SIZE = 1024;
+// past this the orbiting light has faded to almost nothing
+const float POINT_SHADOW_FAR = 40.0f;
+// irradiance, prefiltered environment and BRDF table of the skybox lighting
+const unsigned int IRRADIANCE_UNIT = 10;
+const unsigned int PREFILTER_UNIT = 11;
+const unsigned int BRDF_UNIT = 12;
+// most stars drawn at once, however far the zoom goes
+const unsigned int STAR_BUDGET = 4u << 20;
+// corona around the sun, trail behind the orbiting light, dust along the corridor
+enum ParticleKind {
+    PARTICLE_CORONA,
+    PARTICLE_EXHAUST,
+    PARTICLE_DUST
+};
+
+const glm::vec3 crystalPosition[] = {
+            glm::vec3(2.0f, 0.0f, 10.0f),
+            glm::vec3(-2.0f, 0.0f, 10.0f),
+            glm::vec3(2.0f, 0.0f, 5.0f),
+            glm::vec3(-2.0f, 0.0f, 5.0f),
+            glm::vec3(2.0f, 0.0f, 0.0f),
+            glm::vec3(-2.0f,0.0f, 0.0f),
+            glm::vec3(2.0f,0.0f, -5.0f),
+            glm::vec3(-2.0f,0.0f, -5.0f),
+            glm::vec3(2.0f, 0.0f, -10.0f),
+            glm::vec3(-2.0f,0.0f, -10.0f),
+            glm::vec3(2.0f, 0.0f, -15.0f),
+            glm::vec3(-2.0f, 0.0f, -15.0f),
+            glm::vec3(2.0f, 0.0f, -20.0f),
+            glm::vec3(-2.0f, 0.0f, -20.0f),
+            glm::vec3(2.0f, 0.0f, -25.0f),
+            glm::vec3(-2.0f, 0.0f, -25.0f)
+};
+
+const glm::vec3 spotLightPositions[] = {
+        glm::vec3( 0.0f,  2.5f, -5.0f),
+        glm::vec3( 0.0f, 2.5f, -15.0f),
+        glm::vec3( -4.0f,  2.5f, -26.0f),
+        glm::vec3( 4.0f,  2.5f, -26.0f)
+};
+
+const glm::vec3 sunPosition = glm::vec3(-90.0f, 50.0f, -70.0f);
+
+// key presses that act on objects owned by the render thread
+struct FrameCommands {
+    bool toggleResolution = false;
+    bool reportBloomTiers = false;
+    bool togglePostProfiling = false;
+    bool toggleOverlay = false;
+    bool toggleCapture = false;
+    bool toggleShadows = false;
+    bool togglePointShadows = false;
+    bool toggleEnvironment = false;
+    bool toggleParticles = false;
+    bool reportMemory = false;
+    unsigned int postToggles = 0;
+
+    bool any() const {
+        return toggleResolution || reportBloomTiers || togglePostProfiling || toggleOverlay || toggleCapture ||
+               toggleShadows || togglePointShadows || toggleEnvironment || toggleParticles || reportMemory ||
+               postToggles != 0;
+    }
+};
+FrameCommands pendingCommands;
+
+// everything the render thread needs for one frame; filled by the main thread and
+// read-only once published
+struct FramePacket {
+    int framebufferWidth, framebufferHeight;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::vec3 viewPosition;
+    glm::vec3 lightColor;
+    float exposure;
+    bool bloom;
+    unsigned int bloomTier;
+    glm::vec3 pointLightPosition;
+    // simulated seconds since the previous packet, the particles advance by exactly this much
+    float simulationStep;
+    TransformBatch transforms;
+    unsigned int crystalSlot[16], lightCubeSlot[4];
+    unsigned int sunSlot, orbiterSlot, planeSlot, runestoneSlot;
+    FrameCommands commands;
+};
+
+void renderThread(GLFWwindow *window, FrameQueue<FramePacket> *frames);
+void renderFrames(GLFWwindow *window, FrameQueue<FramePacket> *frames);
+
+struct ObjectTransform {
+    glm::vec3 position;
+    glm::quat rotation;
+    glm::vec3 scale;
+};
+
+// animated world state, advanced only in fixed simulation ticks
+struct SimState {
+    ObjectTransform crystals[16];
+    ObjectTransform sun;
+    ObjectTransform orbiter;
+    glm::vec3 pointLightPosition;
+};
+
+// animation runs at this rate no matter how fast frames are rendered; --sim-hz changes it
+double simulationHz = 60.0;
+
+void simulate(SimState &state, double time);
+LightsBlock packLights(const DirLight &dirLight, const PointLight &pointLight, const SpotLight &spotLight);
+SimState interpolate(const SimState &previous, const SimState &current, float alpha);
+glm::mat4 toMatrix(const ObjectTransform &transform);
+
+
+int main(int argc, char **argv) {
 
-int main() {
+    // --trace <file> profiles from startup and writes a Chrome trace on exit
+    std::string tracePath = "space_trace.json";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--trace" && hasValue) {
+            tracePath = argv[++i];
+            Profiler::setEnabled(true);
+        }
+        else if (arg == "--benchmark")
+            benchmark.enabled = true;
+        else if (arg == "--headless")
+            benchmark.enabled = benchmark.headless = true;
+        else if (arg == "--frames" && hasValue)
+            benchmark.frames = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue)
+            benchmark.warmup = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &benchmark.width, &benchmark.height) != 2 ||
+                benchmark.width <= 0 || benchmark.height <= 0) {
+                std::cout << "Invalid --size, expected WIDTHxHEIGHT\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--bench-out" && hasValue)
+            benchmark.output = argv[++i];
+        else if (arg == "--capture" && hasValue) {
+            capturePath = argv[++i];
+            captureFromStart = true;
+        }
+        else if (arg == "--sim-hz" && hasValue) {
+            simulationHz = std::atof(argv[++i]);
+            if (!(simulationHz > 0.0) || !std::isfinite(simulationHz)) {
+                std::cout << "Invalid --sim-hz, expected a positive rate\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--capture-fps" && hasValue) {
+            captureFps = std::atoi(argv[++i]);
+            if (captureFps <= 0) {
+                std::cout << "Invalid --capture-fps, expected a positive frame rate\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--gl-debug" && hasValue) {
+            std::string level = argv[++i];
+            const char *levels[] = {"notification", "low", "medium", "high"};
+            int severity = GLDebug::NOTIFICATION;
+            while (severity <= GLDebug::HIGH && level != levels[severity])
+                severity++;
+            if (severity > GLDebug::HIGH) {
+                std::cout << "Invalid --gl-debug, expected high, medium, low or notification\n";
+                return EXIT_FAILURE;
+            }
+            glDebugSeverity = (GLDebug::Severity)severity;
+        }
+        else if (arg == "--gl-debug-sync")
+            glDebugSynchronous = true;
+        else if (arg == "--gl-memory")
+            glMemoryTracking = true;
+        // counts heap allocations per frame; once warmed up a steady frame must have none
+        else if (arg == "--alloc-check" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode != "report" && mode != "abort") {
+                std::cout << "Invalid --alloc-check, expected report or abort\n";
+                return EXIT_FAILURE;
+            }
+            AllocationTracker::setMode(mode == "abort" ? AllocationTracker::ABORT : AllocationTracker::REPORT);
+        }
+        else if (arg == "--cube-shadows" && hasValue) {
+            std::string path = argv[++i];
+            if (path == "vertex")
+                cubeShadowPath = PointShadows::VERTEX_LAYER;
+            else if (path == "invocations")
+                cubeShadowPath = PointShadows::GEOMETRY_INVOCATIONS;
+            else if (path == "loop")
+                cubeShadowPath = PointShadows::GEOMETRY_LOOP;
+            else {
+                std::cout << "Invalid --cube-shadows, expected vertex, invocations or loop\n";
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--stars" && hasValue)
+            starCatalogPath = argv[++i];
+        else if (arg == "--particles" && hasValue)
+            particleCapacity = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        else if ((arg == "--record" || arg == "--replay") && hasValue) {
+            pathMode = arg == "--record" ? PATH_RECORD : PATH_REPLAY;
+            pathFile = argv[++i];
+        }
+        else
+            std::cout << "Unknown argument " << arg << std::endl;
+    }
+    Profiler::setThreadName("main");
+    if (pathMode == PATH_REPLAY) {
+        if (!cameraPath.load(pathFile)) {
+            std::cout << "Failed to load camera path " << pathFile << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::cout << "replaying " << pathFile << ": " << cameraPath.duration() << " s" << std::endl;
+    }
 
+#ifdef GLFW_PLATFORM_NULL
+    // GLFW 3.4+: no window system at all, the context comes from EGL or OSMesa alone
+    if (benchmark.headless && glfwPlatformSupported(GLFW_PLATFORM_NULL))
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow *window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "space_walk", nullptr, nullptr);
+    GLFWwindow *window = createWindow(benchmark.width, benchmark.height, benchmark.headless);
     if (window == nullptr) {
         std::cout << "Failed to create a window!\n";
         glfwTerminate();
         return EXIT_FAILURE;
     }
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
 
-    glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!benchmark.headless)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+    camera.Position = glm::vec3(0,0,3);
+    camera.Front = glm::vec3(0,0,-1);
+    camera.WorldUp = glm::vec3(0,1,0);
+
+    // benchmark runs compare fixed work, so the internal resolution must not adapt
+    if (benchmark.enabled)
+        resolution.setEnabled(false);
+    unsigned int benchmarkFrame = 0;
+
+    // the render thread owns the GL context, this thread only simulates and fills frame packets
+    FrameQueue<FramePacket> frames;
+    std::thread renderer(renderThread, window, &frames);
+
+    FixedTimestep simulation(simulationHz);
+    SimState previousState, currentState;
+    simulate(currentState, simulation.time());
+    previousState = currentState;
+    lastFrame = glfwGetTime();
+
+    while(!glfwWindowShouldClose(window)) {
+        // a recorded camera path grows with every tick
+        AllocationTracker::beginFrame(pathMode != PATH_RECORD);
+
+        float currentFrame = glfwGetTime();
+        deltaTime = currentFrame - lastFrame;
+        lastFrame = currentFrame;
+
+        bool replaying = pathMode == PATH_REPLAY;
+        {
+            PROFILE_SCOPE("input");
+            if (!benchmark.enabled || replaying)
+                processInput(window);
+            glfwPollEvents();
+        }
+
+        // benchmarks and replays advance exactly one tick per frame, so every run sees the same scene
+        if (benchmark.enabled && !replaying)
+            scriptedCamera((float)benchmarkFrame++ / (benchmark.warmup + benchmark.frames));
+        unsigned int ticks = simulation.advance(benchmark.enabled || replaying ? simulation.step() : deltaTime);
+        {
+            PROFILE_SCOPE("simulate");
+            for (unsigned int i = 0; i < ticks; i++) {
+                previousState = currentState;
+                simulate(currentState, simulation.time());
+                if (pathMode == PATH_RECORD)
+                    cameraPath.addPose(CameraPath::Pose{simulation.time(), camera.Position, camera.Yaw, camera.Pitch, camera.Zoom});
+            }
+        }
+        simulationTime = simulation.time();
+        for (const CameraPath::KeyEvent &event : recordedKeys)
+            cameraPath.addKey(simulationTime, event.key, event.action);
+        recordedKeys.clear();
+        if (replaying)
+            replayPath(window);
+
+        FramePacket *packet;
+        {
+            PROFILE_SCOPE("wait for packet");
+            packet = frames.beginWrite();
+        }
+        if (packet == nullptr)
+            break;
+        ProfileScope buildZone("build packet");
+        FramePacket &frame = *packet;
+        frame.framebufferWidth = framebufferWidth;
+        frame.framebufferHeight = framebufferHeight;
+        frame.viewPosition = camera.Position;
+        frame.lightColor = lightColor;
+        frame.exposure = exposure;
+        frame.bloom = bloom;
+        frame.bloomTier = bloomTier;
+        frame.commands = pendingCommands;
+        pendingCommands = FrameCommands();
+
+        // model/view/projection
+        float aspect = framebufferHeight > 0 ? (float)framebufferWidth / (float)framebufferHeight : 1.0f;
+        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), aspect, 0.1f, 100.0f);
+        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 model = glm::mat4(1.0f);
+
+        // objects are drawn between the last two ticks, so motion stays smooth at any frame rate
+        SimState state = interpolate(previousState, currentState, simulation.alpha());
+
+        // all object transforms for this frame, computed in one batch
+        frame.transforms.clear();
+        for (int i = 0; i < 16; ++i)
+            frame.crystalSlot[i] = frame.transforms.add(toMatrix(state.crystals[i]));
+        for (unsigned int i = 0; i < 4; i++) {
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::vec3(spotLightPositions[i]));
+            model = glm::scale(model, glm::vec3(0.2f));
+            frame.lightCubeSlot[i] = frame.transforms.add(model);
+        }
+
+        frame.sunSlot = frame.transforms.add(toMatrix(state.sun));
+        frame.orbiterSlot = frame.transforms.add(toMatrix(state.orbiter));
+
+        frame.planeSlot = frame.transforms.add(glm::mat4(1.0f));
+
+        model = glm::mat4(1.0f);
+        model = glm::translate(model, glm::vec3(0.0f, -0.5f, -30.0f));
+        model = glm::scale(model, glm::vec3(0.7f));
+        frame.runestoneSlot = frame.transforms.add(model);
+
+        frame.transforms.compute(projection * view);
+        frame.view = view;
+        frame.projection = projection;
+        frame.pointLightPosition = state.pointLightPosition;
+        frame.simulationStep = (float)(ticks * simulation.step());
+        frames.endWrite();
+        buildZone.end();
+
+        update(window);
+        AllocationTracker::endFrame("main");
+    }
+
+    frames.close();
+    renderer.join();
+    AllocationTracker::summary("main");
+
+    if (pathMode == PATH_RECORD) {
+        if (cameraPath.save(pathFile))
+            std::cout << "camera path written to " << pathFile << " (" << cameraPath.poseCount() << " poses)" << std::endl;
+        else
+            std::cout << "Failed to write camera path " << pathFile << std::endl;
+    }
+
+    // both threads are done recording, so the tracks can be read
+    if (Profiler::eventCount() > 0) {
+        if (Profiler::writeChromeTrace(tracePath))
+            std::cout << "trace written to " << tracePath << std::endl;
+        else
+            std::cout << "Failed to write trace " << tracePath << std::endl;
+    }
+
+    glfwTerminate();
+    return 0;
+}
+
+void renderThread(GLFWwindow *window, FrameQueue<FramePacket> *frames) {
+    Profiler::setThreadName("render");
+    glfwMakeContextCurrent(window);
+    if (benchmark.enabled)
+        glfwSwapInterval(0);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cout << "Failed to init GLAD\n";
-        glfwTerminate();
-        return EXIT_FAILURE;
+        glfwSetWindowShouldClose(window, true);
+        frames->close();
+        return;
     }
+    // before any object exists, so nothing is missed
+    if (glMemoryTracking)
+        GLMemory::install();
+    GLDeletionQueue::loadExtensions((GLADloadproc)glfwGetProcAddress);
+    StreamBuffer::loadExtensions((GLADloadproc)glfwGetProcAddress);
+    ParticleSystem::loadExtensions((GLADloadproc)glfwGetProcAddress);
+#if SPACE_GL_CHECKS
+    bool debugOutput = GLDebug::init((GLADloadproc)glfwGetProcAddress, glDebugSeverity, glDebugSynchronous);
+    std::cout << "GL errors: " << (debugOutput ? "KHR_debug" : "glGetError once per frame") << std::endl;
+#endif
+
+    // every GL object lives inside renderFrames; their handles are gone when it returns and
+    // the names still waiting on a fence are deleted before the context is released
+    renderFrames(window, frames);
+    GLDeletionQueue::flush();
+    if (GLMemory::installed())
+        GLMemory::report(std::cout, true);
+    glfwMakeContextCurrent(nullptr);
+}
 
+void renderFrames(GLFWwindow *window, FrameQueue<FramePacket> *frames) {
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -105,10 +662,6 @@ int main() {
     glCullFace(GL_FRONT);
     glFrontFace(GL_CW);
 
-    camera.Position = glm::vec3(0,0,3);
-    camera.Front = glm::vec3(0,0,-1);
-    camera.WorldUp = glm::vec3(0,1,0);
-
     //shaders
     Shader world("resources/shaders/world.vs", "resources/shaders/world.fs");
     Shader my_blending("resources/shaders/blending.vs", "resources/shaders/blending.fs");
@@ -116,8 +669,7 @@ int main() {
     Shader crystals("resources/shaders/lights.vs", "resources/shaders/lights.fs");
     Shader model_loading("resources/shaders/model.vs", "resources/shaders/model.fs");
     Shader lightCube("resources/shaders/lightcube.vs", "resources/shaders/lightcube.fs");
-    Shader blur("resources/shaders/blur.vs", "resources/shaders/blur.fs");
-    Shader hdr_light("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
+    Shader bright("resources/shaders/bloom.vs", "resources/shaders/bright.fs");
 
 
     //textures
@@ -133,12 +685,11 @@ int main() {
     crystals.setInt("material.diffuse", 1);
     crystals.setInt("material.specular", 2);
 
-    blur.use();
-    blur.setInt("image", 0);
 
-    hdr_light.use();
-    hdr_light.setInt("hdrBuffer", 0);
-    hdr_light.setInt("bloomBlur", 1);
+    bright.use();
+    bright.setInt("hdrBuffer", 0);
+    bright.setFloat("threshold", BLOOM_THRESHOLD);
+    bright.setFloat("knee", BLOOM_KNEE);
 
     vector<std::string> faces
             {
@@ -153,6 +704,12 @@ int main() {
     Cubemap2D cubemap2D0(faces);
     world.use();
     world.setInt("skybox", 0);
+    // the skybox is still loaded, the environment lighting is convolved from it
+    StarCatalog stars(starCatalogPath, "cache/stars.bin", STAR_BUDGET);
+    if (stars.loaded())
+        std::cout << "stars: " << stars.count() << " from the catalog" << std::endl;
+    else
+        std::cout << "stars: no catalog at " << starCatalogPath << ", drawing the skybox" << std::endl;
 
 
     //models
@@ -301,34 +858,6 @@ int main() {
             1.0f, -1.0f, 0.0f, 1.0f, 0.0f
     };
 
-    glm::vec3 crystalPosition[] = {
-                glm::vec3(2.0f, 0.0f, 10.0f),
-                glm::vec3(-2.0f, 0.0f, 10.0f),
-                glm::vec3(2.0f, 0.0f, 5.0f),
-                glm::vec3(-2.0f, 0.0f, 5.0f),
-                glm::vec3(2.0f, 0.0f, 0.0f),
-                glm::vec3(-2.0f,0.0f, 0.0f),
-                glm::vec3(2.0f,0.0f, -5.0f),
-                glm::vec3(-2.0f,0.0f, -5.0f),
-                glm::vec3(2.0f, 0.0f, -10.0f),
-                glm::vec3(-2.0f,0.0f, -10.0f),
-                glm::vec3(2.0f, 0.0f, -15.0f),
-                glm::vec3(-2.0f, 0.0f, -15.0f),
-                glm::vec3(2.0f, 0.0f, -20.0f),
-                glm::vec3(-2.0f, 0.0f, -20.0f),
-                glm::vec3(2.0f, 0.0f, -25.0f),
-                glm::vec3(-2.0f, 0.0f, -25.0f)
-    };
-
-    glm::vec3 spotLightPositions[] = {
-            glm::vec3( 0.0f,  2.5f, -5.0f),
-            glm::vec3( 0.0f, 2.5f, -15.0f),
-            glm::vec3( -4.0f,  2.5f, -26.0f),
-            glm::vec3( 4.0f,  2.5f, -26.0f)
-    };
-
-    glm::vec3 sunPosition = glm::vec3(-90.0f, 50.0f, -70.0f);
-
     DirLight dirLight;
     dirLight.direction = sunPosition;
     dirLight.ambient = glm::vec3(1.0f, 1.0f, 1.0f);
@@ -356,13 +885,15 @@ int main() {
     spotLight.cutOff = glm::cos(glm::radians(33.5f));
     spotLight.outerCutOff = glm::cos(glm::radians(50.0f));
 
-    unsigned int planeVBO, planeVAO, crystalVBO, crystalVAO, cubeVBO, cubeVAO, worldVBO, worldVAO, quadVBO, quadVAO;
+    GLMemory::pushOwner("scene geometry", __FILE__, __LINE__);
+    GLBuffer planeVBO = GLBuffer::create(), crystalVBO = GLBuffer::create(), cubeVBO = GLBuffer::create(),
+             worldVBO = GLBuffer::create(), quadVBO = GLBuffer::create();
+    GLVertexArray planeVAO = GLVertexArray::create(), crystalVAO = GLVertexArray::create(),
+                  cubeVAO = GLVertexArray::create(), worldVAO = GLVertexArray::create(), quadVAO = GLVertexArray::create();
 
     //plane
-    glGenVertexArrays(1, &planeVAO);
-    glGenBuffers(1, &planeVBO);
-    glBindVertexArray(planeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
+    glBindVertexArray(planeVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, planeVBO.get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -370,10 +901,8 @@ int main() {
     glEnableVertexAttribArray(1);
 
     //crystal
-    glGenVertexArrays(1, &crystalVAO);
-    glGenBuffers(1, &crystalVBO);
-    glBindVertexArray(crystalVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, crystalVBO);
+    glBindVertexArray(crystalVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, crystalVBO.get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(crystalVertices), crystalVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -383,10 +912,8 @@ int main() {
     glEnableVertexAttribArray(2);
 
     //light cubes
-    glGenVertexArrays(1, &cubeVAO);
-    glGenBuffers(1, &cubeVBO);
-    glBindVertexArray(cubeVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
+    glBindVertexArray(cubeVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, cubeVBO.get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(crystalVertices), crystalVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
@@ -396,484 +923,711 @@ int main() {
     glEnableVertexAttribArray(2);
 
     //world cube
-    glGenVertexArrays(1, &worldVAO);
-    glGenBuffers(1, &worldVBO);
-    glBindVertexArray(worldVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, worldVBO);
+    glBindVertexArray(worldVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, worldVBO.get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
     //quad
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBindVertexArray(quadVAO.get());
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO.get());
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
+    GLDebug::label(GL_VERTEX_ARRAY, planeVAO.get(), "plane");
+    GLDebug::label(GL_VERTEX_ARRAY, crystalVAO.get(), "crystal");
+    GLDebug::label(GL_VERTEX_ARRAY, cubeVAO.get(), "light cube");
+    GLDebug::label(GL_VERTEX_ARRAY, worldVAO.get(), "skybox");
+    GLDebug::label(GL_VERTEX_ARRAY, quadVAO.get(), "fullscreen quad");
+    GLMemory::popOwner();
+
 
     //HDR, Bloom
-    unsigned int hdrFBO;
-    glGenFramebuffers(1, &hdrFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-
-    unsigned int colorBuffer[2];
-    glGenTextures(2, colorBuffer);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindTexture(GL_TEXTURE_2D, colorBuffer[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, colorBuffer[i], 0);
-    }
-
-    unsigned int rboDepth;
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
-    unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-    glDrawBuffers(2, attachments);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-        std::cout << "Framebuffer not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
-    }
+    // scene, bloom and resolve targets are transient frame graph resources
+    RenderTargetPool targetPool;
+    FrameGraph graph(targetPool);
+    int sceneWidth = SCR_WIDTH, sceneHeight = SCR_HEIGHT;
+
+    Bloom bloomChain(bloomTiers[bloomTier].levels, sceneWidth / BRIGHT_PASS_DIVISOR, sceneHeight / BRIGHT_PASS_DIVISOR);
+    GpuTimer tierTimers[BLOOM_TIER_COUNT];
+    bloomTimers = tierTimers;
+    unsigned int activeBloomTier = bloomTier;
+    // tonemapping and the other per-pixel effects run fused in the resolve pass
+    PostStack post;
+
+    PerfOverlay overlay;
+    // free video memory is only reported through vendor extensions
+    bool nvxMemoryInfo = glfwExtensionSupported("GL_NVX_gpu_memory_info");
+    bool atiMemoryInfo = glfwExtensionSupported("GL_ATI_meminfo");
+    auto lastSwap = std::chrono::steady_clock::now();
+    // moving average of the frame time, for the frame rate of a video
+    double averageFrameMs = 0.0;
+    unsigned long measuredFrames = 0;
+    FrameStats benchmarkStats;
+    benchmarkStats.reserve(benchmark.frames);
+    unsigned int renderedFrames = 0;
+    // kept between frames, so the pass list keeps its storage
+    PerfOverlay::Stats overlayStats;
 
 
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-
-
-    while(!glfwWindowShouldClose(window)) {
-
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
-
-        processInput(window);
-        glfwPollEvents();
+    RenderQueue queue(100.0f);
+
+    // per-frame uniform data is streamed through a fenced ring instead of glUniform calls
+    StreamBuffer lightsBuffer(GL_UNIFORM_BUFFER, 4 * 1024);
+    GLDebug::label(GL_BUFFER, lightsBuffer.id(), "lights ring");
+    crystals.bindUniformBlock("Lights", LIGHTS_BINDING);
+    sun.bindUniformBlock("Lights", LIGHTS_BINDING);
+    model_loading.bindUniformBlock("Lights", LIGHTS_BINDING);
+    crystals.bindUniformBlock("Shadows", SHADOWS_BINDING);
+    model_loading.bindUniformBlock("Shadows", SHADOWS_BINDING);
+    std::cout << "stream buffers: " << (lightsBuffer.persistent() ? "persistent mapping" : "glBufferSubData") << std::endl;
+
+    // cascades cover the first 60 units around the camera
+    ShadowCascades sunShadows(SHADOW_MAP_SIZE, 0.1f, 60.0f);
+    sunShadows.setLight(dirLight.direction);
+    sunShadows.bind(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+    crystals.use();
+    crystals.setInt("shadowMap", SHADOW_MAP_UNIT);
+    model_loading.use();
+    model_loading.setInt("shadowMap", SHADOW_MAP_UNIT);
+    // model matrices of the static casters as of the last frame, a change invalidates the cached layer
+    glm::mat4 staticCasters[5];
+    for (auto &model : staticCasters)
+        model = glm::mat4(0.0f);
+
+    // shadows of the orbiting light; the orbiter itself holds the light and casts none
+    PointShadows pointShadows(POINT_SHADOW_SIZE, 0.1f, POINT_SHADOW_FAR, cubeShadowPath);
+    pointShadows.bind(GL_TEXTURE0 + POINT_SHADOW_UNIT);
+    crystals.use();
+    crystals.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+    model_loading.use();
+    model_loading.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+    std::cout << "point shadows: " << PointShadows::pathName(pointShadows.path()) << std::endl;
+    // bounding radii in model space, for the per-face culling
+    float crystalRadius = 0.0f;
+    for (size_t v = 0; v < sizeof(crystalVertices) / sizeof(float); v += 8)
+        crystalRadius = std::max(crystalRadius, glm::length(glm::vec3(crystalVertices[v], crystalVertices[v + 1],
+                                                                      crystalVertices[v + 2])));
+    float runestoneRadius = ourModel.BoundingRadius();
+
+    // ambient light from the skybox, convolved once and then read back from the disk cache
+    EnvironmentLighting environment(cubemap2D0.id(), faces, worldVAO.get(), quadVAO.get());
+    std::cout << "environment lighting: " << (environment.fromCache() ? "loaded " : "convolved and cached to ")
+              << environment.cachePath() << " in " << environment.buildMs() << " ms" << std::endl;
+    environment.bind(GL_TEXTURE0 + IRRADIANCE_UNIT, GL_TEXTURE0 + PREFILTER_UNIT, GL_TEXTURE0 + BRDF_UNIT);
+    for (Shader *lit : {&crystals, &model_loading}) {
+        lit->use();
+        lit->setInt("irradianceMap", IRRADIANCE_UNIT);
+        lit->setInt("prefilterMap", PREFILTER_UNIT);
+        lit->setInt("brdfLUT", BRDF_UNIT);
+    }
+    bool environmentLighting = true;
+
+    // the emitters follow the sun and the orbiter, the particles themselves never touch the CPU
+    ParticleSystem particles(std::max(1u, particleCapacity));
+    particles.setEnabled(particleCapacity > 0);
+    float sunRadius = sunModel.BoundingRadius() * 0.1f;
+    particles.setKind(PARTICLE_CORONA, glm::vec3(2.0f, 0.9f, 0.3f), sunRadius * 0.04f, 0.3f);
+    particles.setKind(PARTICLE_EXHAUST, glm::vec3(0.6f, 0.8f, 1.6f), 0.06f, 1.5f);
+    particles.setKind(PARTICLE_DUST, glm::vec3(0.08f), 0.03f, 0.0f);
+    ParticleSystem::Emitter corona;
+    corona.extent = glm::vec3(sunRadius);
+    corona.speed = sunRadius * 0.2f;
+    corona.life = glm::vec2(2.0f, 4.0f);
+    corona.rate = 150000.0f;
+    corona.kind = PARTICLE_CORONA;
+    unsigned int coronaEmitter = particles.addEmitter(corona);
+    ParticleSystem::Emitter exhaust;
+    exhaust.extent = glm::vec3(0.05f);
+    exhaust.speed = 0.6f;
+    exhaust.life = glm::vec2(1.0f, 2.5f);
+    exhaust.rate = 60000.0f;
+    exhaust.kind = PARTICLE_EXHAUST;
+    unsigned int exhaustEmitter = particles.addEmitter(exhaust);
+    ParticleSystem::Emitter dust;
+    dust.shape = ParticleSystem::BOX;
+    dust.position = glm::vec3(0.0f, 2.25f, -11.5f);
+    dust.extent = glm::vec3(6.0f, 2.75f, 23.5f);
+    dust.speed = 0.05f;
+    dust.life = glm::vec2(8.0f, 15.0f);
+    dust.rate = 20000.0f;
+    dust.kind = PARTICLE_DUST;
+    particles.addEmitter(dust);
+    std::cout << "particles: " << particleCapacity << ", count "
+              << (particles.gpuDriven() ? "kept on the GPU" : "read back every frame") << std::endl;
+
+    GpuProfiler gpuProfiler;
+    FrameCapture capture;
+    bool captureRequested = captureFromStart;
+
+    while (true) {
+        FramePacket *packet;
+        {
+            PROFILE_SCOPE("wait for frame");
+            packet = frames->beginRead();
+        }
+        if (packet == nullptr)
+            break;
+        const FramePacket &frame = *packet;
+        // commands, resizes and recording may allocate; the scene size follows the scale from the last frame
+        AllocationTracker::beginFrame(!frame.commands.any() && !capture.recording() &&
+                                      resolution.scaled(frame.framebufferWidth) == sceneWidth &&
+                                      resolution.scaled(frame.framebufferHeight) == sceneHeight);
+        ProfileScope setupZone("frame setup");
+        gpuProfiler.collect();
+        const TransformBatch &transforms = frame.transforms;
+        const glm::mat4 &projection = frame.projection;
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        // model/view/projection
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        glm::mat4 model = glm::mat4(1.0f);
-        float time = glfwGetTime();
-
-
-
-
-        crystals.use();
-        glBindVertexArray(crystalVAO);
-
-        texture2D1.active(GL_TEXTURE1);
-        texture2D2.active(GL_TEXTURE2);
-
-
-        crystals.setVec3("dirLight.direction", dirLight.direction);
-        crystals.setVec3("dirLight.ambient", dirLight.ambient);
-        crystals.setVec3("dirLight.diffuse", dirLight.diffuse);
-        crystals.setVec3("dirLight.specular", dirLight.specular);
-
-        crystals.setVec3("pointLight.position", glm::vec3(5.0f * cos(time), 5.0f, 8.0f * sin(time) - 10.0f));
-        crystals.setVec3("pointLight.ambient", pointLight.ambient);
-        crystals.setVec3("pointLight.diffuse", pointLight.diffuse);
-        crystals.setVec3("pointLight.specular", pointLight.specular);
-        crystals.setFloat("pointLight.constant", pointLight.constant);
-        crystals.setFloat("pointLight.linear", pointLight.linear);
-        crystals.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        crystals.setVec3("spotLight[0].position", spotLightPositions[0]);
-        crystals.setVec3("spotLight[0].direction", spotLight.direction);
-        crystals.setVec3("spotLight[0].ambient", spotLight.ambient);
-        crystals.setVec3("spotLight[0].diffuse", spotLight.diffuse);
-        crystals.setVec3("spotLight[0].specular", spotLight.specular);
-        crystals.setFloat("spotLight[0].constant", spotLight.constant);
-        crystals.setFloat("spotLight[0].linear", spotLight.linear);
-        crystals.setFloat("spotLight[0].quadratic", spotLight.quadratic);
-        crystals.setFloat("spotLight[0].cutOff", spotLight.cutOff);
-        crystals.setFloat("spotLight[0].outerCutOff", spotLight.outerCutOff);
-
-        crystals.setVec3("spotLight[1].position", spotLightPositions[1]);
-        crystals.setVec3("spotLight[1].direction", spotLight.direction);
-        crystals.setVec3("spotLight[1].ambient", spotLight.ambient);
-        crystals.setVec3("spotLight[1].diffuse", spotLight.diffuse);
-        crystals.setVec3("spotLight[1].specular", spotLight.specular);
-        crystals.setFloat("spotLight[1].constant", spotLight.constant);
-        crystals.setFloat("spotLight[1].linear", spotLight.linear);
-        crystals.setFloat("spotLight[1].quadratic", spotLight.quadratic);
-        crystals.setFloat("spotLight[1].cutOff", spotLight.cutOff);
-        crystals.setFloat("spotLight[1].outerCutOff", spotLight.outerCutOff);
-
-        crystals.setVec3("spotLight[2].position", spotLightPositions[2]);
-        crystals.setVec3("spotLight[2].direction", spotLight.direction);
-        crystals.setVec3("spotLight[2].ambient", spotLight.ambient);
-        crystals.setVec3("spotLight[2].diffuse", spotLight.diffuse);
-        crystals.setVec3("spotLight[2].specular", spotLight.specular);
-        crystals.setFloat("spotLight[2].constant", spotLight.constant);
-        crystals.setFloat("spotLight[2].linear", spotLight.linear);
-        crystals.setFloat("spotLight[2].quadratic", spotLight.quadratic);
-        crystals.setFloat("spotLight[2].cutOff", spotLight.cutOff);
-        crystals.setFloat("spotLight[2].outerCutOff", spotLight.outerCutOff);
-
-        crystals.setVec3("spotLight[3].position", spotLightPositions[3]);
-        crystals.setVec3("spotLight[3].direction", spotLight.direction);
-        crystals.setVec3("spotLight[3].ambient", spotLight.ambient);
-        crystals.setVec3("spotLight[3].diffuse", spotLight.diffuse);
-        crystals.setVec3("spotLight[3].specular", spotLight.specular);
-        crystals.setFloat("spotLight[3].constant", spotLight.constant);
-        crystals.setFloat("spotLight[3].linear", spotLight.linear);
-        crystals.setFloat("spotLight[3].quadratic", spotLight.quadratic);
-        crystals.setFloat("spotLight[3].cutOff", spotLight.cutOff);
-        crystals.setFloat("spotLight[3].outerCutOff", spotLight.outerCutOff);
-
-        crystals.setVec3("lightColor", lightColor);
-        crystals.setVec3("viewPos", camera.Position);
-        crystals.setFloat("material.shininess", 32.0f);
-        crystals.setMat4("projection", projection);
-        crystals.setMat4("view", view);
-        for (int i = 0; i < 16; ++i) {
-            time = glfwGetTime() + i/2.0f;
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, crystalPosition[i]);
-            model = glm::translate(model, glm::vec3(0.0f, 2*sin(time), 0.0f));
-            model = glm::scale(model, glm::vec3(0.4f, 1.5f, 0.4f));
-            crystals.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 60);
+        if (GLStats::installed())
+            GLStats::reset();
+        lightsBuffer.beginFrame();
+        // the sun is lit by the static point light, everything else by the orbiting one
+        StreamBuffer::Allocation sunLights = lightsBuffer.upload(packLights(dirLight, pointLight, spotLight));
+        PointLight orbitingLight = pointLight;
+        orbitingLight.position = frame.pointLightPosition;
+        StreamBuffer::Allocation sceneLights = lightsBuffer.upload(packLights(dirLight, orbitingLight, spotLight));
+
+        sunShadows.update(frame.viewPosition);
+        const unsigned int staticSlots[5] = {frame.runestoneSlot, frame.lightCubeSlot[0], frame.lightCubeSlot[1],
+                                             frame.lightCubeSlot[2], frame.lightCubeSlot[3]};
+        for (unsigned int i = 0; i < 5; i++) {
+            glm::mat4 model = transforms.model(staticSlots[i]);
+            if (model != staticCasters[i]) {
+                staticCasters[i] = model;
+                sunShadows.invalidateStatic();
+            }
+        }
+        StreamBuffer::Allocation shadowBlock = lightsBuffer.upload(sunShadows.block(frame.viewPosition));
+        lightsBuffer.flush();
+        lightsBuffer.bindRange(SHADOWS_BINDING, shadowBlock);
+
+        // requests from key presses, handled here since the objects live on this thread
+        const FrameCommands &commands = frame.commands;
+        if (commands.toggleResolution) {
+            resolution.setEnabled(!resolution.enabled());
+            reportResolution();
+        }
+        if (commands.reportBloomTiers)
+            reportBloomTiers();
+        for (unsigned int s = 0; s < PostStack::STAGE_COUNT; s++) {
+            if (commands.postToggles & (1u << s)) {
+                post.toggle((PostStack::Stage)s);
+                std::cout << PostStack::stageName(s) << ": " << (post.enabled((PostStack::Stage)s) ? "on" : "off") << std::endl;
+            }
+        }
+        if (commands.toggleCapture)
+            captureRequested = !captureRequested;
+        if (commands.toggleEnvironment) {
+            environmentLighting = !environmentLighting;
+            std::cout << "environment lighting: " << (environmentLighting ? "on" : "off") << std::endl;
+        }
+        if (commands.reportMemory) {
+            if (GLMemory::installed())
+                GLMemory::report(std::cout, false);
+            else
+                std::cout << "GL objects are tracked only with --gl-memory" << std::endl;
+        }
+        if (commands.toggleParticles && particleCapacity > 0) {
+            particles.setEnabled(!particles.enabled());
+            std::cout << "particles: " << (particles.enabled() ? "on" : "off") << ", " << particles.alive() << " of "
+                      << particles.capacity() << " alive" << std::endl;
+        }
+        if (commands.togglePointShadows) {
+            pointShadows.setEnabled(!pointShadows.enabled());
+            std::cout << "point shadows: " << (pointShadows.enabled() ? "on" : "off") << ", last pass drew "
+                      << pointShadows.casters() << " casters into " << pointShadows.faceDraws() << " faces" << std::endl;
+        }
+        if (commands.toggleShadows) {
+            sunShadows.setEnabled(!sunShadows.enabled());
+            std::cout << "sun shadows: " << (sunShadows.enabled() ? "on" : "off") << ", static layers redrawn "
+                      << sunShadows.staticRenders() << " times" << std::endl;
+        }
+        if (commands.toggleOverlay)
+            overlay.toggle();
+        if (commands.togglePostProfiling) {
+            post.report();
+            post.setProfiling(!post.profiling());
+            std::cout << "post profiling: " << (post.profiling() ? "on" : "off") << std::endl;
         }
 
+        // scene targets follow the internal resolution; the pool drops targets of sizes no longer used
+        sceneWidth = resolution.scaled(frame.framebufferWidth);
+        sceneHeight = resolution.scaled(frame.framebufferHeight);
+        int brightWidth = std::max(1, sceneWidth / BRIGHT_PASS_DIVISOR);
+        int brightHeight = std::max(1, sceneHeight / BRIGHT_PASS_DIVISOR);
+        bloomChain.resize(brightWidth, brightHeight);
 
+        if (activeBloomTier != frame.bloomTier) {
+            activeBloomTier = frame.bloomTier;
+            bloomChain.setLevels(bloomTiers[frame.bloomTier].levels);
+        }
 
+        graph.reset();
+        FrameGraph::Resource hdrColor = graph.create("hdrColor", TextureDesc(sceneWidth, sceneHeight, GL_RGBA16F));
+        FrameGraph::Resource sceneDepth = graph.create("sceneDepth", TextureDesc(sceneWidth, sceneHeight, GL_DEPTH_COMPONENT24));
+        FrameGraph::Resource brightColor = graph.create("brightColor", TextureDesc(brightWidth, brightHeight, GL_R11F_G11F_B10F));
+        FrameGraph::Resource bloomResult = graph.import("bloom", bloomChain.output(), TextureDesc(brightWidth / 2, brightHeight / 2, GL_R11F_G11F_B10F));
+        FrameGraph::Resource backbuffer = graph.backbuffer(frame.framebufferWidth, frame.framebufferHeight);
+        FrameGraph::Resource pointShadowMap = graph.import("pointShadows", pointShadows.texture(),
+                                                           TextureDesc(POINT_SHADOW_SIZE, POINT_SHADOW_SIZE, GL_DEPTH_COMPONENT24));
+        FrameGraph::Resource sunShadowMap = graph.import("sunShadows", sunShadows.texture(),
+                                                         TextureDesc(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, GL_DEPTH_COMPONENT24));
+        // the particle buffers are no texture, the resource only orders the update before the scene
+        FrameGraph::Resource particleState = graph.import("particles", 0, TextureDesc(1, 1, GL_R8));
+
+        // draws go through the render queue, which orders them by pass, state and depth
+        queue.reset();
+        queue.setPassSetup(RenderQueue::OPAQUE, []() {
+            glDepthFunc(GL_LESS);
+            glEnable(GL_CULL_FACE);
+        });
+        queue.setPassSetup(RenderQueue::SKY, []() {
+            glDepthFunc(GL_LEQUAL);
+        });
+        queue.setPassSetup(RenderQueue::TRANSPARENT, []() {
+            glDepthFunc(GL_LESS);
+            glDisable(GL_CULL_FACE);
+        });
+        auto cameraDistance = [&](unsigned int slot) {
+            return glm::length(glm::vec3(transforms.model(slot)[3]) - frame.viewPosition);
+        };
+
+        unsigned int crystalsProgram = queue.addProgram([&]() {
+            crystals.use();
+            lightsBuffer.bindRange(LIGHTS_BINDING, sceneLights);
+            crystals.setVec3("lightColor", frame.lightColor);
+            crystals.setVec3("viewPos", frame.viewPosition);
+            crystals.setFloat("material.shininess", 32.0f);
+            crystals.setFloat("pointShadowFar", pointShadows.enabled() ? POINT_SHADOW_FAR : 0.0f);
+            crystals.setFloat("iblStrength", environmentLighting ? 1.0f : 0.0f);
+        });
+        unsigned int crystalMaterial = queue.addMaterial([&]() {
+            glBindVertexArray(crystalVAO.get());
+            texture2D1.active(GL_TEXTURE1);
+            texture2D2.active(GL_TEXTURE2);
+        });
+        for (int i = 0; i < 16; ++i) {
+            unsigned int slot = frame.crystalSlot[i];
+            queue.submit(RenderQueue::OPAQUE, crystalsProgram, crystalMaterial, cameraDistance(slot), [&, slot]() {
+                transforms.apply(crystals, slot);
+                glDrawArrays(GL_TRIANGLES, 0, 60);
+            });
+        }
 
-        lightCube.use();
-        glBindVertexArray(cubeVAO);
-
-        lightCube.setMat4("projection", projection);
-        lightCube.setMat4("view", view);
+        unsigned int lightCubeProgram = queue.addProgram([&]() {
+            lightCube.use();
+            lightCube.setVec3("lightColor", frame.lightColor);
+        });
+        unsigned int cubeMaterial = queue.addMaterial([&]() {
+            glBindVertexArray(cubeVAO.get());
+        });
         for (unsigned int i = 0; i < 4; i++) {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(spotLightPositions[i]));
-            model = glm::scale(model, glm::vec3(0.2f));
-            lightCube.setMat4("model", model);
-            lightCube.setVec3("lightColor", lightColor);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-        }
-
-
-
-
-
-        sun.use();
-
-        sun.setVec3("dirLight.direction", dirLight.direction);
-        sun.setVec3("dirLight.ambient", dirLight.ambient);
-        sun.setVec3("dirLight.diffuse", dirLight.diffuse);
-        sun.setVec3("dirLight.specular", dirLight.specular);
-
-        sun.setVec3("pointLight.position", pointLight.position);
-        sun.setVec3("pointLight.ambient", pointLight.ambient);
-        sun.setVec3("pointLight.diffuse", pointLight.diffuse);
-        sun.setVec3("pointLight.specular", pointLight.specular);
-        sun.setFloat("pointLight.constant", pointLight.constant);
-        sun.setFloat("pointLight.linear", pointLight.linear);
-        sun.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        sun.setVec3("spotLight[0].position", spotLightPositions[0]);
-        sun.setVec3("spotLight[0].direction", spotLight.direction);
-        sun.setVec3("spotLight[0].ambient", spotLight.ambient);
-        sun.setVec3("spotLight[0].diffuse", spotLight.diffuse);
-        sun.setVec3("spotLight[0].specular", spotLight.specular);
-        sun.setFloat("spotLight[0].constant", spotLight.constant);
-        sun.setFloat("spotLight[0].linear", spotLight.linear);
-        sun.setFloat("spotLight[0].quadratic", spotLight.quadratic);
-        sun.setFloat("spotLight[0].cutOff", spotLight.cutOff);
-        sun.setFloat("spotLight[0].outerCutOff", spotLight.outerCutOff);
-
-        sun.setVec3("spotLight[1].position", spotLightPositions[1]);
-        sun.setVec3("spotLight[1].direction", spotLight.direction);
-        sun.setVec3("spotLight[1].ambient", spotLight.ambient);
-        sun.setVec3("spotLight[1].diffuse", spotLight.diffuse);
-        sun.setVec3("spotLight[1].specular", spotLight.specular);
-        sun.setFloat("spotLight[1].constant", spotLight.constant);
-        sun.setFloat("spotLight[1].linear", spotLight.linear);
-        sun.setFloat("spotLight[1].quadratic", spotLight.quadratic);
-        sun.setFloat("spotLight[1].cutOff", spotLight.cutOff);
-        sun.setFloat("spotLight[1].outerCutOff", spotLight.outerCutOff);
-
-        sun.setVec3("spotLight[2].position", spotLightPositions[2]);
-        sun.setVec3("spotLight[2].direction", spotLight.direction);
-        sun.setVec3("spotLight[2].ambient", spotLight.ambient);
-        sun.setVec3("spotLight[2].diffuse", spotLight.diffuse);
-        sun.setVec3("spotLight[2].specular", spotLight.specular);
-        sun.setFloat("spotLight[2].constant", spotLight.constant);
-        sun.setFloat("spotLight[2].linear", spotLight.linear);
-        sun.setFloat("spotLight[2].quadratic", spotLight.quadratic);
-        sun.setFloat("spotLight[2].cutOff", spotLight.cutOff);
-        sun.setFloat("spotLight[2].outerCutOff", spotLight.outerCutOff);
-
-        sun.setVec3("spotLight[3].position", spotLightPositions[3]);
-        sun.setVec3("spotLight[3].direction", spotLight.direction);
-        sun.setVec3("spotLight[3].ambient", spotLight.ambient);
-        sun.setVec3("spotLight[3].diffuse", spotLight.diffuse);
-        sun.setVec3("spotLight[3].specular", spotLight.specular);
-        sun.setFloat("spotLight[3].constant", spotLight.constant);
-        sun.setFloat("spotLight[3].linear", spotLight.linear);
-        sun.setFloat("spotLight[3].quadratic", spotLight.quadratic);
-        sun.setFloat("spotLight[3].cutOff", spotLight.cutOff);
-        sun.setFloat("spotLight[3].outerCutOff", spotLight.outerCutOff);
-
-        sun.setVec3("viewPosition", camera.Position);
-        sun.setMat4("projection", projection);
-        sun.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, sunPosition);
-        model = glm::rotate(model, time, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.1f));
-        sun.setMat4("model", model);
-
-        sunModel.Draw(sun);
-
-        sun.use();
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(5.0f * cos(time), 5.0f, 8.0f * sin(time) - 10.0f));
-        model = glm::rotate(model, time, glm::vec3(1.0f, 1.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.002f));
-        model_loading.setMat4("model", model);
-
-        sunModel.Draw(sun);
-
-
-
-
-
-
-        glDepthFunc(GL_LEQUAL);
-        world.use();
-        glBindVertexArray(worldVAO);
-
-        cubemap2D0.active(GL_TEXTURE0);
-
-        glm::mat4 view1 = glm::mat4(glm::mat3(camera.GetViewMatrix()));
-        world.setMat4("view", view1);
-        world.setMat4("projection", projection);
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-
-
-
-
-        glDisable(GL_CULL_FACE);
-        my_blending.use();
-        glBindVertexArray(planeVAO);
-
-        texture2D0.active(GL_TEXTURE0);
-
-        my_blending.setVec3("lightColor", lightColor);
-        my_blending.setMat4("projection", projection);
-        my_blending.setMat4("view", view);
-        my_blending.setMat4("model", glm::mat4(1.0f));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glEnable(GL_CULL_FACE);
-
-
-
-
-
-        model_loading.use();
-
-        model_loading.setVec3("dirLight.direction", dirLight.direction);
-        model_loading.setVec3("dirLight.ambient", dirLight.ambient);
-        model_loading.setVec3("dirLight.diffuse", dirLight.diffuse);
-        model_loading.setVec3("dirLight.specular", dirLight.specular);
-
-        model_loading.setVec3("pointLight.position", glm::vec3(5.0f * cos(time), 5.0f, 8.0f * sin(time) - 10.0f));
-        model_loading.setVec3("pointLight.ambient", pointLight.ambient);
-        model_loading.setVec3("pointLight.diffuse", pointLight.diffuse);
-        model_loading.setVec3("pointLight.specular", pointLight.specular);
-        model_loading.setFloat("pointLight.constant", pointLight.constant);
-        model_loading.setFloat("pointLight.linear", pointLight.linear);
-        model_loading.setFloat("pointLight.quadratic", pointLight.quadratic);
-
-        model_loading.setVec3("spotLight[0].position", spotLightPositions[0]);
-        model_loading.setVec3("spotLight[0].direction", spotLight.direction);
-        model_loading.setVec3("spotLight[0].ambient", spotLight.ambient);
-        model_loading.setVec3("spotLight[0].diffuse", spotLight.diffuse);
-        model_loading.setVec3("spotLight[0].specular", spotLight.specular);
-        model_loading.setFloat("spotLight[0].constant", spotLight.constant);
-        model_loading.setFloat("spotLight[0].linear", spotLight.linear);
-        model_loading.setFloat("spotLight[0].quadratic", spotLight.quadratic);
-        model_loading.setFloat("spotLight[0].cutOff", spotLight.cutOff);
-        model_loading.setFloat("spotLight[0].outerCutOff", spotLight.outerCutOff);
-
-        model_loading.setVec3("spotLight[1].position", spotLightPositions[1]);
-        model_loading.setVec3("spotLight[1].direction", spotLight.direction);
-        model_loading.setVec3("spotLight[1].ambient", spotLight.ambient);
-        model_loading.setVec3("spotLight[1].diffuse", spotLight.diffuse);
-        model_loading.setVec3("spotLight[1].specular", spotLight.specular);
-        model_loading.setFloat("spotLight[1].constant", spotLight.constant);
-        model_loading.setFloat("spotLight[1].linear", spotLight.linear);
-        model_loading.setFloat("spotLight[1].quadratic", spotLight.quadratic);
-        model_loading.setFloat("spotLight[1].cutOff", spotLight.cutOff);
-        model_loading.setFloat("spotLight[1].outerCutOff", spotLight.outerCutOff);
-
-        model_loading.setVec3("spotLight[2].position", spotLightPositions[2]);
-        model_loading.setVec3("spotLight[2].direction", spotLight.direction);
-        model_loading.setVec3("spotLight[2].ambient", spotLight.ambient);
-        model_loading.setVec3("spotLight[2].diffuse", spotLight.diffuse);
-        model_loading.setVec3("spotLight[2].specular", spotLight.specular);
-        model_loading.setFloat("spotLight[2].constant", spotLight.constant);
-        model_loading.setFloat("spotLight[2].linear", spotLight.linear);
-        model_loading.setFloat("spotLight[2].quadratic", spotLight.quadratic);
-        model_loading.setFloat("spotLight[2].cutOff", spotLight.cutOff);
-        model_loading.setFloat("spotLight[2].outerCutOff", spotLight.outerCutOff);
-
-        model_loading.setVec3("spotLight[3].position", spotLightPositions[3]);
-        model_loading.setVec3("spotLight[3].direction", spotLight.direction);
-        model_loading.setVec3("spotLight[3].ambient", spotLight.ambient);
-        model_loading.setVec3("spotLight[3].diffuse", spotLight.diffuse);
-        model_loading.setVec3("spotLight[3].specular", spotLight.specular);
-        model_loading.setFloat("spotLight[3].constant", spotLight.constant);
-        model_loading.setFloat("spotLight[3].linear", spotLight.linear);
-        model_loading.setFloat("spotLight[3].quadratic", spotLight.quadratic);
-        model_loading.setFloat("spotLight[3].cutOff", spotLight.cutOff);
-        model_loading.setFloat("spotLight[3].outerCutOff", spotLight.outerCutOff);
-
-        model_loading.setVec3("lightColor", lightColor);
-        model_loading.setVec3("viewPosition", camera.Position);
-        model_loading.setMat4("projection", projection);
-        model_loading.setMat4("view", view);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -0.5f, -30.0f));
-        model = glm::scale(model, glm::vec3(0.7f));
-        model_loading.setMat4("model", model);
-
-        ourModel.Draw(model_loading);
-
-
+            unsigned int slot = frame.lightCubeSlot[i];
+            queue.submit(RenderQueue::OPAQUE, lightCubeProgram, cubeMaterial, cameraDistance(slot), [&, slot]() {
+                transforms.apply(lightCube, slot);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            });
+        }
 
+        // models bind their own meshes and textures
+        unsigned int modelMaterial = queue.addMaterial([]() {});
+
+        unsigned int sunProgram = queue.addProgram([&]() {
+            sun.use();
+            lightsBuffer.bindRange(LIGHTS_BINDING, sunLights);
+            sun.setVec3("viewPosition", frame.viewPosition);
+        });
+        for (unsigned int slot : {frame.sunSlot, frame.orbiterSlot}) {
+            queue.submit(RenderQueue::OPAQUE, sunProgram, modelMaterial, cameraDistance(slot), [&, slot]() {
+                transforms.apply(sun, slot);
+                sunModel.Draw(sun);
+            });
+        }
 
+        unsigned int modelProgram = queue.addProgram([&]() {
+            model_loading.use();
+            lightsBuffer.bindRange(LIGHTS_BINDING, sceneLights);
+            model_loading.setVec3("lightColor", frame.lightColor);
+            model_loading.setVec3("viewPosition", frame.viewPosition);
+            model_loading.setFloat("pointShadowFar", pointShadows.enabled() ? POINT_SHADOW_FAR : 0.0f);
+            model_loading.setFloat("iblStrength", environmentLighting ? 1.0f : 0.0f);
+        });
+        queue.submit(RenderQueue::OPAQUE, modelProgram, modelMaterial, cameraDistance(frame.runestoneSlot), [&]() {
+            transforms.apply(model_loading, frame.runestoneSlot);
+            ourModel.Draw(model_loading);
+        });
+
+        if (stars.loaded()) {
+            unsigned int starProgram = queue.addProgram([]() {});
+            unsigned int starMaterial = queue.addMaterial([]() {});
+            queue.submit(RenderQueue::SKY, starProgram, starMaterial, 0.0f, [&]() {
+                stars.draw(glm::mat4(glm::mat3(frame.view)), projection);
+            });
+        }
+        else {
+            unsigned int skyProgram = queue.addProgram([&]() {
+                world.use();
+                world.setMat4("view", glm::mat4(glm::mat3(frame.view)));
+                world.setMat4("projection", projection);
+            });
+            unsigned int skyMaterial = queue.addMaterial([&]() {
+                glBindVertexArray(worldVAO.get());
+                cubemap2D0.active(GL_TEXTURE0);
+            });
+            queue.submit(RenderQueue::SKY, skyProgram, skyMaterial, 0.0f, []() {
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+            });
+        }
 
+        unsigned int blendingProgram = queue.addProgram([&]() {
+            my_blending.use();
+            my_blending.setVec3("lightColor", frame.lightColor);
+        });
+        unsigned int planeMaterial = queue.addMaterial([&]() {
+            glBindVertexArray(planeVAO.get());
+            texture2D0.active(GL_TEXTURE0);
+        });
+        queue.submit(RenderQueue::TRANSPARENT, blendingProgram, planeMaterial, cameraDistance(frame.planeSlot), [&]() {
+            my_blending.setMat4("mvp", transforms.mvp(frame.planeSlot));
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        });
+
+        // additive, so the sprites need no sorting among themselves
+        if (particles.enabled()) {
+            unsigned int particleProgram = queue.addProgram([]() {});
+            unsigned int particleMaterial = queue.addMaterial([]() {});
+            queue.submit(RenderQueue::TRANSPARENT, particleProgram, particleMaterial, 0.0f, [&]() {
+                particles.render(projection * frame.view, projection[1][1] * sceneHeight * 0.5f);
+            });
+        }
 
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 20;
-        blur.use();
-        glBindVertexArray(quadVAO);
-        for (unsigned int i = 0; i < amount; i++)
+        // the runestone and the lamp cubes go to the cached layers, the moving objects are drawn over them every frame
+        unsigned int shadowPass = graph.addPass("shadows", [&](const FrameGraph &) {
+            sunShadows.render([&](Shader &depth) {
+                depth.setMat4("model", transforms.model(frame.runestoneSlot));
+                ourModel.DrawGeometry();
+                glBindVertexArray(cubeVAO.get());
+                for (unsigned int slot : frame.lightCubeSlot) {
+                    depth.setMat4("model", transforms.model(slot));
+                    glDrawArrays(GL_TRIANGLES, 0, 36);
+                }
+            }, [&](Shader &depth) {
+                glBindVertexArray(crystalVAO.get());
+                for (unsigned int slot : frame.crystalSlot) {
+                    depth.setMat4("model", transforms.model(slot));
+                    glDrawArrays(GL_TRIANGLES, 0, 60);
+                }
+                depth.setMat4("model", transforms.model(frame.orbiterSlot));
+                sunModel.DrawGeometry();
+            });
+            glBindVertexArray(0);
+        }, true);
+        graph.write(shadowPass, sunShadowMap);
+
+        // one draw per caster for all six faces, casters only go to the faces they reach
+        unsigned int pointShadowPass = graph.addPass("point shadows", [&](const FrameGraph &) {
+            pointShadows.begin(frame.pointLightPosition);
+            glBindVertexArray(crystalVAO.get());
+            for (unsigned int slot : frame.crystalSlot)
+                pointShadows.draw(transforms.model(slot), crystalRadius, [](GLsizei instances) {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 60, instances);
+                });
+            glBindVertexArray(cubeVAO.get());
+            for (unsigned int slot : frame.lightCubeSlot)
+                pointShadows.draw(transforms.model(slot), crystalRadius, [](GLsizei instances) {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, 36, instances);
+                });
+            pointShadows.draw(transforms.model(frame.runestoneSlot), runestoneRadius, [&](GLsizei instances) {
+                ourModel.DrawGeometry(instances);
+            });
+            pointShadows.end();
+        }, true);
+        graph.write(pointShadowPass, pointShadowMap);
+
+        unsigned int particlePass = graph.addPass("particles", [&](const FrameGraph &) {
+            ParticleSystem::Emitter &coronaSource = particles.emitter(coronaEmitter);
+            coronaSource.position = glm::vec3(transforms.model(frame.sunSlot)[3]);
+            particles.emitter(exhaustEmitter).position = frame.pointLightPosition;
+            particles.update(frame.simulationStep);
+        }, true);
+        graph.write(particlePass, particleState);
+
+        unsigned int scenePass = graph.addPass("scene", [&](const FrameGraph &) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            queue.execute();
+            glBindVertexArray(0);
+            glDepthFunc(GL_LESS);
+            glEnable(GL_CULL_FACE);
+        });
+        graph.write(scenePass, hdrColor);
+        graph.write(scenePass, sceneDepth);
+        // with the shadows off nothing reads the map and the pass is culled
+        if (sunShadows.enabled())
+            graph.read(scenePass, sunShadowMap);
+        if (pointShadows.enabled())
+            graph.read(scenePass, pointShadowMap);
+        if (particles.enabled())
+            graph.read(scenePass, particleState);
+
+        // bloom threshold with a soft knee, extracted from the HDR target at reduced resolution
+        unsigned int brightPass = graph.addPass("bright", [&](const FrameGraph &g) {
+            bright.use();
+            glDisable(GL_DEPTH_TEST);
+            glBindVertexArray(quadVAO.get());
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, g.texture(hdrColor));
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glEnable(GL_DEPTH_TEST);
+        });
+        graph.read(brightPass, hdrColor);
+        graph.write(brightPass, brightColor);
+
+        // the bloom chain renders into its own mips; with bloom off nothing reads it and the pass is culled
+        unsigned int bloomPass = graph.addPass("bloom", [&](const FrameGraph &g) {
+            bloomTimers[activeBloomTier].begin();
+            bloomChain.render(g.texture(brightColor), quadVAO.get());
+            bloomTimers[activeBloomTier].end();
+        }, true);
+        graph.read(bloomPass, brightColor);
+        graph.write(bloomPass, bloomResult);
+
+        // resolve upscales the internal resolution to the window
+        unsigned int resolvePass = graph.addPass("resolve", [&](const FrameGraph &g) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            post.render(g.texture(hdrColor), frame.bloom ? g.texture(bloomResult) : 0, frame.bloom,
+                        bloomChain.strength(), frame.exposure, quadVAO.get());
+        });
+        graph.read(resolvePass, hdrColor);
+        if (frame.bloom)
+            graph.read(resolvePass, bloomResult);
+        graph.write(resolvePass, backbuffer);
+
+        graph.compile();
+        setupZone.end();
+        graph.execute(&gpuProfiler);
+
+        // the video keeps the size it was started with, a resize ends the recording
+        if (capture.recording() && (!captureRequested || capture.width() != (frame.framebufferWidth & ~1) ||
+                                    capture.height() != (frame.framebufferHeight & ~1))) {
+            capture.stop();
+            reportCapture(capture);
+            captureRequested = false;
+        }
+        // benchmarks and replays render one simulation step per frame, so the video runs at the simulation
+        // rate; otherwise it plays at the rate frames were rendered, which is known after the first frames
+        int videoFps = captureFps;
+        if (videoFps == 0 && (benchmark.enabled || pathMode == PATH_REPLAY))
+            videoFps = (int)std::lround(simulationHz);
+        else if (videoFps == 0 && measuredFrames >= CAPTURE_RATE_FRAMES)
+            videoFps = std::max(1, (int)std::lround(1000.0 / averageFrameMs));
+        if (captureRequested && !capture.recording() && videoFps > 0) {
+            if (capture.start(capturePath, frame.framebufferWidth, frame.framebufferHeight, videoFps))
+                std::cout << "recording " << capturePath << " at " << videoFps << " fps" << std::endl;
+            else {
+                std::cout << "Failed to start recording " << capturePath << std::endl;
+                captureRequested = false;
+            }
+        }
+        // read back before the overlay is drawn, so the video shows only the scene
         {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blur.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffer[1] : pingpongColorbuffers[!horizontal]);
+            PROFILE_SCOPE("capture");
+            GLDebugGroup group("capture");
+            capture.capture();
+        }
 
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
+        auto now = std::chrono::steady_clock::now();
+        float frameMs = std::chrono::duration<float, std::milli>(now - lastSwap).count();
+        lastSwap = now;
+        overlay.addFrame(frameMs);
+        averageFrameMs = measuredFrames++ == 0 ? frameMs : averageFrameMs * 0.95 + frameMs * 0.05;
+
+        if (benchmark.enabled && renderedFrames++ >= benchmark.warmup && benchmarkStats.frames() < benchmark.frames) {
+            benchmarkStats.addFrame(frameMs);
+            for (unsigned int i = 0; i < graph.passCount(); i++)
+                benchmarkStats.addPass(graph.passName(i), graph.passCpuMs(i), graph.passGpuMs(i));
+            if (benchmarkStats.frames() == benchmark.frames)
+                glfwSetWindowShouldClose(window, true);
         }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
+        if (overlay.visible()) {
+            PROFILE_SCOPE("overlay");
+            GLDebugGroup group("overlay");
+            gpuProfiler.begin("overlay");
+            PerfOverlay::Stats &stats = overlayStats;
+            stats.passes.clear();
+            for (unsigned int i = 0; i < graph.passCount(); i++)
+                stats.passes.push_back(PerfOverlay::PassTiming{graph.passName(i), graph.passCpuMs(i), graph.passGpuMs(i)});
+            stats.counters = GLStats::counters();
+            stats.queueDraws = queue.drawCount();
+            stats.programBinds = queue.programBinds();
+            stats.materialBinds = queue.materialBinds();
+            stats.targetBytes = targetPool.bytes();
+            stats.glObjectBytes = GLMemory::installed() ? (long long)GLMemory::totalBytes() : -1;
+            GLint freeKb[4] = {-1, -1, -1, -1};
+            if (nvxMemoryInfo)
+                glGetIntegerv(0x9049, freeKb); // GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX
+            else if (atiMemoryInfo)
+                glGetIntegerv(0x87FC, freeKb); // GL_TEXTURE_FREE_MEMORY_ATI
+            stats.freeVramKb = freeKb[0];
+            stats.resolutionScale = resolution.scale();
+            overlay.render(stats, frame.framebufferWidth, frame.framebufferHeight, frameMs / 1000.0f);
+            gpuProfiler.end();
+        }
+        // summed from the passes' own timers, so capture waits and the overlay's CPU work do not count
+        resolution.update(graph.gpuMs() + (overlay.visible() ? overlay.gpuMs() : 0.0));
+
+        lightsBuffer.endFrame();
+        // what was released this frame is deleted once the GPU is past it
+        GLDeletionQueue::endFrame();
+        GLDeletionQueue::collect();
+        frames->endRead();
+        GLDebug::checkErrors("frame");
+        PROFILE_SCOPE("swap");
+        glfwSwapBuffers(window);
+        AllocationTracker::endFrame("render");
+    }
 
+    AllocationTracker::summary("render");
+    reportBloomTiers();
+    bloomTimers = nullptr;
+    reportResolution();
+    post.report();
+    if (capture.recording()) {
+        capture.stop();
+        reportCapture(capture);
+    }
+    if (benchmark.enabled)
+        writeBenchmarkReport(benchmarkStats);
+}
 
+GLFWwindow *createWindow(int width, int height, bool headless) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if SPACE_GL_CHECKS
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+    if (!headless)
+        return glfwCreateWindow(width, height, "space_walk", nullptr, nullptr);
+
+    // a surfaceless EGL context where the driver has one, Mesa's OSMesa (llvmpipe) otherwise
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    const int contextApis[] = {GLFW_EGL_CONTEXT_API, GLFW_OSMESA_CONTEXT_API};
+    for (int api : contextApis) {
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+        GLFWwindow *window = glfwCreateWindow(width, height, "space_walk", nullptr, nullptr);
+        if (window != nullptr) {
+            std::cout << "headless context: " << (api == GLFW_EGL_CONTEXT_API ? "EGL" : "OSMesa") << std::endl;
+            return window;
+        }
+    }
+    return nullptr;
+}
 
+// flies down the crystal corridor looking from side to side; progress runs from 0 to 1
+void scriptedCamera(float progress) {
+    const float TWO_PI = 6.2831853f;
+    glm::vec3 position(1.5f * sin(progress * 2.0f * TWO_PI),
+                       1.0f + 0.5f * sin(progress * TWO_PI),
+                       12.0f - 40.0f * progress);
+    float yaw = -90.0f + 50.0f * sin(progress * 3.0f * TWO_PI);
+    float pitch = 15.0f * sin(progress * 1.5f * TWO_PI);
+    camera.SetPose(position, yaw, pitch);
+}
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        hdr_light.use();
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, colorBuffer[0]);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        hdr_light.setInt("bloom", bloom);
-        hdr_light.setFloat("exposure", exposure);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+void reportCapture(const FrameCapture &capture) {
+    std::cout << "recorded " << capture.frames() << " frames (" << capture.width() << "x" << capture.height()
+              << ") to " << capturePath << ", render thread waited " << capture.waits() << " times" << std::endl;
+}
 
+// input polled every frame comes from the recording while a path is replayed
+bool keyDown(GLFWwindow *window, int key) {
+    if (pathMode == PATH_REPLAY)
+        return cameraPath.keyDown(key);
+    return glfwGetKey(window, key) == GLFW_PRESS;
+}
 
-        update(window);
-        glfwSwapBuffers(window);
+// applies the recorded key presses and camera pose for the latest tick
+void replayPath(GLFWwindow *window) {
+    static double previousTime = 0.0;
+    auto replay = [window](int key, int action) {
+        key_callback(window, key, 0, action, 0);
+    };
+    double time = simulationTime;
+    // a benchmark may run longer than the recording, the flight then starts over
+    if (benchmark.enabled && cameraPath.duration() > 0.0) {
+        time = std::fmod(time, cameraPath.duration());
+        // the rest of the old loop's keys play out, held keys are let go and the events start over
+        if (time < previousTime) {
+            cameraPath.replayKeys(cameraPath.duration(), replay);
+            for (int key : cameraPath.heldKeys())
+                key_callback(window, key, 0, GLFW_RELEASE, 0);
+            cameraPath.rewind();
+        }
     }
+    else if (!benchmark.enabled && time > cameraPath.duration())
+        glfwSetWindowShouldClose(window, true);
+    previousTime = time;
+    cameraPath.replayKeys(time, replay);
+    CameraPath::Pose pose = cameraPath.sample(time);
+    camera.SetPose(pose.position, pose.yaw, pose.pitch);
+    camera.Zoom = pose.zoom;
+}
 
+void writeBenchmarkReport(const FrameStats &stats) {
+    FrameStats::Summary frame = stats.frameSummary();
+    std::cout << "benchmark: " << stats.frames() << " frames, mean " << frame.mean << " ms, p50 " << frame.p50
+              << " ms, p95 " << frame.p95 << " ms, p99 " << frame.p99 << " ms, max " << frame.max << " ms" << std::endl;
 
-    glDeleteBuffers(1, &worldVBO);
-    glDeleteBuffers(1, &planeVBO);
-    glDeleteBuffers(1, &crystalVBO);
-    glDeleteBuffers(1, &quadVBO);
-    glDeleteVertexArrays(1, &worldVAO);
-    glDeleteVertexArrays(1, &planeVAO);
-    glDeleteVertexArrays(1, &crystalVAO);
-    glDeleteVertexArrays(1, &cubeVAO);
-    glDeleteVertexArrays(1, &quadVAO);
-    world.deleteProgram();
-    crystals.deleteProgram();
-    my_blending.deleteProgram();
-    model_loading.deleteProgram();
-    lightCube.deleteProgram();
-    sun.deleteProgram();
-    blur.deleteProgram();
-    hdr_light.deleteProgram();
-
-    glfwTerminate();
-    return 0;
+    std::ofstream out(benchmark.output);
+    if (!out) {
+        std::cout << "Failed to write " << benchmark.output << std::endl;
+        return;
+    }
+    out << "{\"renderer\": \"" << (const char *)glGetString(GL_RENDERER) << "\", \"width\": " << benchmark.width
+        << ", \"height\": " << benchmark.height << ", \"warmup\": " << benchmark.warmup
+        << ", \"bloom_tier\": \"" << bloomTiers[bloomTier].name << "\", \"results\": ";
+    stats.writeJson(out);
+    out << "}\n";
+    std::cout << "benchmark results written to " << benchmark.output << std::endl;
 }
 
 
 
 void processInput(GLFWwindow *window)
 {
-    if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+    if(keyDown(window, GLFW_KEY_ESCAPE))
         glfwSetWindowShouldClose(window, true);
 
-    if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if(keyDown(window, GLFW_KEY_W))
         camera.ProcessKeyboard(FORWARD, deltaTime);
-    if(glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if(keyDown(window, GLFW_KEY_S))
         camera.ProcessKeyboard(BACKWARD, deltaTime);
-    if(glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if(keyDown(window, GLFW_KEY_A))
         camera.ProcessKeyboard(LEFT, deltaTime);
-    if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if(keyDown(window, GLFW_KEY_D))
         camera.ProcessKeyboard(RIGHT, deltaTime);
 
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !bloomKeyPressed)
+    if (keyDown(window, GLFW_KEY_SPACE) && !bloomKeyPressed)
     {
         bloom = !bloom;
         bloomKeyPressed = true;
         std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
     }
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE)
+    if (!keyDown(window, GLFW_KEY_SPACE))
     {
         bloomKeyPressed = false;
     }
 
-    if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+    if (keyDown(window, GLFW_KEY_Q))
     {
         if (exposure > 0.0f) {
             exposure -= 0.05f;
@@ -884,7 +1638,7 @@ void processInput(GLFWwindow *window)
             std::cout << "bloom: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
         }
     }
-    else if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+    else if (keyDown(window, GLFW_KEY_E))
     {
         exposure += 0.05f;
         std::cout << "hdr: " << (bloom ? "on" : "off") << "| exposure: " << exposure << std::endl;
@@ -895,11 +1649,88 @@ void update(GLFWwindow *window) {
 
 }
 
+void simulate(SimState &state, double time) {
+    for (int i = 0; i < 16; ++i) {
+        // neighbouring crystals bob half a second apart
+        float phase = (float)time + i/2.0f;
+        state.crystals[i].position = crystalPosition[i] + glm::vec3(0.0f, 2*sin(phase), 0.0f);
+        state.crystals[i].rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        state.crystals[i].scale = glm::vec3(0.4f, 1.5f, 0.4f);
+    }
+
+    float t = (float)time;
+    state.sun.position = sunPosition;
+    state.sun.rotation = glm::angleAxis(t, glm::vec3(0.0f, 1.0f, 0.0f));
+    state.sun.scale = glm::vec3(0.1f);
+
+    state.pointLightPosition = glm::vec3(5.0f * cos(t), 5.0f, 8.0f * sin(t) - 10.0f);
+    state.orbiter.position = state.pointLightPosition;
+    state.orbiter.rotation = glm::angleAxis(t, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+    state.orbiter.scale = glm::vec3(0.002f);
+}
+
+ObjectTransform interpolate(const ObjectTransform &previous, const ObjectTransform &current, float alpha) {
+    ObjectTransform result;
+    result.position = glm::mix(previous.position, current.position, alpha);
+    result.rotation = glm::slerp(previous.rotation, current.rotation, alpha);
+    result.scale = glm::mix(previous.scale, current.scale, alpha);
+    return result;
+}
+
+SimState interpolate(const SimState &previous, const SimState &current, float alpha) {
+    SimState result;
+    for (int i = 0; i < 16; ++i)
+        result.crystals[i] = interpolate(previous.crystals[i], current.crystals[i], alpha);
+    result.sun = interpolate(previous.sun, current.sun, alpha);
+    result.orbiter = interpolate(previous.orbiter, current.orbiter, alpha);
+    result.pointLightPosition = glm::mix(previous.pointLightPosition, current.pointLightPosition, alpha);
+    return result;
+}
+
+LightsBlock packLights(const DirLight &dirLight, const PointLight &pointLight, const SpotLight &spotLight) {
+    LightsBlock block = {};
+    block.dirLight.direction = dirLight.direction;
+    block.dirLight.ambient = dirLight.ambient;
+    block.dirLight.diffuse = dirLight.diffuse;
+    block.dirLight.specular = dirLight.specular;
+
+    block.pointLight.position = pointLight.position;
+    block.pointLight.ambient = pointLight.ambient;
+    block.pointLight.diffuse = pointLight.diffuse;
+    block.pointLight.specular = pointLight.specular;
+    block.pointLight.constant = pointLight.constant;
+    block.pointLight.linear = pointLight.linear;
+    block.pointLight.quadratic = pointLight.quadratic;
+
+    for (unsigned int i = 0; i < 4; i++) {
+        block.spotLight[i].position = spotLightPositions[i];
+        block.spotLight[i].direction = spotLight.direction;
+        block.spotLight[i].cutOff = spotLight.cutOff;
+        block.spotLight[i].outerCutOff = spotLight.outerCutOff;
+        block.spotLight[i].ambient = spotLight.ambient;
+        block.spotLight[i].diffuse = spotLight.diffuse;
+        block.spotLight[i].specular = spotLight.specular;
+        block.spotLight[i].constant = spotLight.constant;
+        block.spotLight[i].linear = spotLight.linear;
+        block.spotLight[i].quadratic = spotLight.quadratic;
+    }
+    return block;
+}
+
+glm::mat4 toMatrix(const ObjectTransform &transform) {
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), transform.position);
+    model = model * glm::mat4_cast(transform.rotation);
+    return glm::scale(model, transform.scale);
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
+    framebufferWidth = width;
+    framebufferHeight = height;
 }
 
 void key_callback(GLFWwindow * window, int key, int scancode, int action, int mods) {
+    if (pathMode == PATH_RECORD && action != GLFW_REPEAT)
+        recordedKeys.push_back(CameraPath::KeyEvent{0.0, key, action});
 
     if(key == GLFW_KEY_R && action == GLFW_PRESS) {
         lightColor = glm::vec3(1.0f, 0.0f, 0.0f);
@@ -916,6 +1747,59 @@ void key_callback(GLFWwindow * window, int key, int scancode, int action, int mo
     if(key == GLFW_KEY_M && action == GLFW_PRESS) {
         lightColor = glm::vec3(1.0f, 1.0f, 1.0f);
     }
+
+    if(key == GLFW_KEY_T && action == GLFW_PRESS) {
+        pendingCommands.reportBloomTiers = true;
+        bloomTier = (bloomTier + 1) % BLOOM_TIER_COUNT;
+        std::cout << "bloom quality: " << bloomTiers[bloomTier].name << std::endl;
+    }
+
+    if(key == GLFW_KEY_V && action == GLFW_PRESS) {
+        pendingCommands.toggleResolution = !pendingCommands.toggleResolution;
+    }
+
+    // 1-4 toggle the post stages, P toggles per-stage profiling
+    if(key >= GLFW_KEY_1 && key < GLFW_KEY_1 + PostStack::STAGE_COUNT && action == GLFW_PRESS) {
+        pendingCommands.postToggles ^= 1u << (key - GLFW_KEY_1);
+    }
+
+    if(key == GLFW_KEY_F1 && action == GLFW_PRESS) {
+        pendingCommands.toggleOverlay = !pendingCommands.toggleOverlay;
+    }
+
+    // F2 starts and stops recording the trace written on exit
+    if(key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+        pendingCommands.toggleCapture = !pendingCommands.toggleCapture;
+    }
+
+    if(key == GLFW_KEY_F4 && action == GLFW_PRESS) {
+        pendingCommands.toggleShadows = !pendingCommands.toggleShadows;
+    }
+
+    if(key == GLFW_KEY_F5 && action == GLFW_PRESS) {
+        pendingCommands.togglePointShadows = !pendingCommands.togglePointShadows;
+    }
+
+    if(key == GLFW_KEY_F6 && action == GLFW_PRESS) {
+        pendingCommands.toggleEnvironment = !pendingCommands.toggleEnvironment;
+    }
+
+    if(key == GLFW_KEY_F7 && action == GLFW_PRESS) {
+        pendingCommands.toggleParticles = !pendingCommands.toggleParticles;
+    }
+
+    if(key == GLFW_KEY_F8 && action == GLFW_PRESS) {
+        pendingCommands.reportMemory = true;
+    }
+
+    if(key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        Profiler::setEnabled(!Profiler::enabled());
+        std::cout << "profiler: " << (Profiler::enabled() ? "recording" : "paused") << std::endl;
+    }
+
+    if(key == GLFW_KEY_P && action == GLFW_PRESS) {
+        pendingCommands.togglePostProfiling = !pendingCommands.togglePostProfiling;
+    }
 }
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos)
@@ -940,5 +1824,24 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(yoffset);
 }
 
+void reportBloomTiers() {
+    if (bloomTimers == nullptr)
+        return;
+    for (unsigned int i = 0; i < BLOOM_TIER_COUNT; i++) {
+        std::cout << "bloom " << bloomTiers[i].name << " (" << bloomTiers[i].levels << " levels): ";
+        if (bloomTimers[i].samples() == 0)
+            std::cout << "not measured" << std::endl;
+        else
+            std::cout << bloomTimers[i].averageMs() << " ms gpu" << std::endl;
+    }
+}
+
+void reportResolution() {
+    std::cout << "dynamic resolution: " << (resolution.enabled() ? "on" : "off")
+              << "| scale: " << resolution.scale()
+              << "| gpu: " << resolution.gpuMs() << " ms"
+              << "| target: " << resolution.targetMs() << " ms" << std::endl;
+}
+
 
 